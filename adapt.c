@@ -0,0 +1,140 @@
+#include "adapt.h"
+
+static bool     adapt_enabled;
+static uint32_t adapt_floor_ms   = ADAPT_FLOOR_DEFAULT_MS;
+static uint32_t adapt_ceiling_ms = ADAPT_CEILING_DEFAULT_MS;
+static uint32_t adapt_rate       = ADAPT_RATE_DEFAULT;
+static uint32_t adapt_period_ms  = ADAPT_FLOOR_DEFAULT_MS;    // last period requested
+static bool     adapt_have_last;
+static int32_t  adapt_last;                                   // previous sample
+
+/******************************************************************************
+ * @brief Feed a new sample to the controller. While the rate of change stays
+ *        below half the threshold the period is stretched towards the
+ *        ceiling, above the threshold it shrinks towards the floor. The new
+ *        period takes effect at the next LETIMER period boundary
+ * @param centi_c = temperature in hundredths of a degree celsius
+ * @return none
+ *****************************************************************************/
+void Adapt_Sample(int32_t centi_c) {
+    uint32_t change;
+    uint32_t budget;
+    uint32_t elapsed_ms = letimer_get_ended_period();         // since the previous sample, a new period may already run
+    uint32_t period_ms = adapt_period_ms;
+
+    change = (centi_c > adapt_last) ? (centi_c - adapt_last) : (adapt_last - centi_c);
+    adapt_last = centi_c;
+    if (!adapt_enabled || !adapt_have_last) {
+        adapt_have_last = true;
+        return;
+    }
+
+    /* change * 60000 / elapsed_ms against adapt_rate, scaled by 1/100 so it neither divides nor overflows */
+    budget = adapt_rate * (elapsed_ms / 100);
+    if ((change * (60000 / 100)) > budget) {
+        period_ms >>= ADAPT_SHRINK_SHIFT;                     // react quickly
+    }
+    else if ((change * 2 * (60000 / 100)) < budget) {
+        period_ms += period_ms >> ADAPT_STRETCH_SHIFT;        // back off gradually
+    }
+    if (period_ms < adapt_floor_ms) {
+        period_ms = adapt_floor_ms;
+    }
+    if (period_ms > adapt_ceiling_ms) {
+        period_ms = adapt_ceiling_ms;
+    }
+    if (period_ms != adapt_period_ms) {
+        adapt_period_ms = period_ms;
+        letimer_set_period(period_ms, letimer_get_powerup());
+    }
+}
+/******************************************************************************
+ * @brief Turn the controller on or off. Off returns to the floor period
+ * @param enable = true to adapt the period
+ * @return none
+ *****************************************************************************/
+void Adapt_Enable(bool enable) {
+    adapt_enabled = enable;
+    adapt_have_last = false;
+    if (!enable && (adapt_period_ms != adapt_floor_ms)) {
+        adapt_period_ms = adapt_floor_ms;
+        letimer_set_period(adapt_floor_ms, letimer_get_powerup());
+    }
+}
+/******************************************************************************
+ * @brief Set the shortest period, used as the fixed period while disabled
+ * @param floor_ms = TEMP_PERIOD_MIN_MS to TEMP_PERIOD_MAX_MS
+ * @return false if out of range
+ *****************************************************************************/
+bool Adapt_Set_Floor(uint32_t floor_ms) {
+    if (!letimer_set_period(floor_ms, letimer_get_powerup())) {
+        return false;
+    }
+    adapt_floor_ms = floor_ms;
+    adapt_period_ms = floor_ms;                               // restart from the fast end
+    if (adapt_ceiling_ms < floor_ms) {
+        adapt_ceiling_ms = floor_ms;
+    }
+    return true;
+}
+/******************************************************************************
+ * @brief Set the longest period the controller stretches to
+ * @param ceiling_ms = TEMP_PERIOD_MIN_MS to TEMP_PERIOD_MAX_MS
+ * @return false if out of range
+ *****************************************************************************/
+bool Adapt_Set_Ceiling(uint32_t ceiling_ms) {
+    if ((ceiling_ms < TEMP_PERIOD_MIN_MS) || (ceiling_ms > TEMP_PERIOD_MAX_MS)) {
+        return false;
+    }
+    adapt_ceiling_ms = ceiling_ms;
+    if (adapt_floor_ms > ceiling_ms) {
+        Adapt_Set_Floor(ceiling_ms);
+    }
+    return true;
+}
+/******************************************************************************
+ * @brief Set the rate of change that counts as fast
+ * @param rate = hundredths of a degree celsius per minute, up to
+ *        ADAPT_RATE_MAX
+ * @return false if out of range
+ *****************************************************************************/
+bool Adapt_Set_Rate(uint32_t rate) {
+    if (rate > ADAPT_RATE_MAX) {
+        return false;
+    }
+    adapt_rate = rate;
+    return true;
+}
+/******************************************************************************
+ * @brief Copy the settings and the controller state out
+ * @param state = destination
+ * @return none
+ *****************************************************************************/
+void Adapt_Save(Adapt_Retained * state) {
+    state->floor_ms   = adapt_floor_ms;
+    state->ceiling_ms = adapt_ceiling_ms;
+    state->rate       = adapt_rate;
+    state->period_ms  = adapt_period_ms;
+    state->last       = adapt_last;
+    state->enabled    = adapt_enabled;
+    state->have_last  = adapt_have_last;
+}
+/******************************************************************************
+ * @brief Reload the state saved by Adapt_Save, e.g. after an EM4 wakeup. The
+ *        LETIMER period is restored separately
+ * @param state = source, ignored if its periods or rate are out of range
+ * @return none
+ *****************************************************************************/
+void Adapt_Restore(const Adapt_Retained * state) {
+    if ((state->floor_ms < TEMP_PERIOD_MIN_MS) || (state->ceiling_ms > TEMP_PERIOD_MAX_MS)
+            || (state->floor_ms > state->ceiling_ms) || (state->rate > ADAPT_RATE_MAX)) {
+        return;
+    }
+    adapt_floor_ms   = state->floor_ms;
+    adapt_ceiling_ms = state->ceiling_ms;
+    adapt_rate       = state->rate;
+    adapt_period_ms  = state->period_ms;
+    adapt_last       = state->last;
+    adapt_enabled    = state->enabled;
+    adapt_have_last  = state->have_last;
+}
@@ -0,0 +1,114 @@
+/**************************************************************************//**
+ * @file adapt.h
+ * @brief Adaptive sample period controller header
+ * @author Silicon Labs
+ * @version 1.00
+ ******************************************************************************
+ * @section License
+ * <b>(C) Copyright 2014 Silicon Labs, http://www.silabs.com</b>
+ *******************************************************************************
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ * DISCLAIMER OF WARRANTY/LIMITATION OF REMEDIES: Silicon Labs has no
+ * obligation to support this Software. Silicon Labs is providing the
+ * Software "AS IS", with no express or implied warranties of any kind,
+ * including, but not limited to, any implied warranties of merchantability
+ * or fitness for any particular purpose or warranties against infringement
+ * of any proprietary rights of a third party.
+ *
+ * Silicon Labs will not be liable for any consequential, incidental, or
+ * special damages, or any other relief, or for any claim by any third party,
+ * arising from your use of this Software.
+ *
+ ******************************************************************************/
+#ifndef SRC_ADAPT_H_
+#define SRC_ADAPT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "timer.h"
+
+#define ADAPT_FLOOR_DEFAULT_MS     TEMP_MEAS_PERIOD_MS          // fastest rate, also set by ?pN#
+#define ADAPT_CEILING_DEFAULT_MS    300000                      // slowest rate, 5 minutes (?uN#)
+#define ADAPT_RATE_DEFAULT              50                      // hundredths of a degree C per minute (?tN#)
+#define ADAPT_RATE_MAX  (UINT32_MAX / (TEMP_PERIOD_MAX_MS / 100))   // 119304, rate * period / 100 fits 32 bits
+#define ADAPT_SHRINK_SHIFT               2                      // fast change: period / 4
+#define ADAPT_STRETCH_SHIFT              1                      // stable: period + period / 2
+
+/******************************************************************************
+ * @brief Settings and controller state, kept across EM4 hibernation
+ *****************************************************************************/
+typedef struct {
+    uint32_t floor_ms;
+    uint32_t ceiling_ms;
+    uint32_t rate;
+    uint32_t period_ms;                                         // last period requested
+    int32_t  last;                                              // previous sample
+    bool     enabled;
+    bool     have_last;
+} Adapt_Retained;
+
+/******************************************************************************
+ * @brief Feed a new sample to the controller. While the rate of change stays
+ *        below half the threshold the period is stretched towards the
+ *        ceiling, above the threshold it shrinks towards the floor. The new
+ *        period takes effect at the next LETIMER period boundary
+ * @param centi_c = temperature in hundredths of a degree celsius
+ * @return none
+ *****************************************************************************/
+void Adapt_Sample(int32_t centi_c);
+
+/******************************************************************************
+ * @brief Turn the controller on or off. Off returns to the floor period
+ * @param enable = true to adapt the period
+ * @return none
+ *****************************************************************************/
+void Adapt_Enable(bool enable);
+
+/******************************************************************************
+ * @brief Set the shortest period, used as the fixed period while disabled
+ * @param floor_ms = TEMP_PERIOD_MIN_MS to TEMP_PERIOD_MAX_MS
+ * @return false if out of range
+ *****************************************************************************/
+bool Adapt_Set_Floor(uint32_t floor_ms);
+
+/******************************************************************************
+ * @brief Set the longest period the controller stretches to
+ * @param ceiling_ms = TEMP_PERIOD_MIN_MS to TEMP_PERIOD_MAX_MS
+ * @return false if out of range
+ *****************************************************************************/
+bool Adapt_Set_Ceiling(uint32_t ceiling_ms);
+
+/******************************************************************************
+ * @brief Set the rate of change that counts as fast
+ * @param rate = hundredths of a degree celsius per minute, up to
+ *        ADAPT_RATE_MAX
+ * @return false if out of range
+ *****************************************************************************/
+bool Adapt_Set_Rate(uint32_t rate);
+
+/******************************************************************************
+ * @brief Copy the settings and the controller state out
+ * @param state = destination
+ * @return none
+ *****************************************************************************/
+void Adapt_Save(Adapt_Retained * state);
+
+/******************************************************************************
+ * @brief Reload the state saved by Adapt_Save, e.g. after an EM4 wakeup. The
+ *        LETIMER period is restored separately
+ * @param state = source, ignored if its periods or rate are out of range
+ * @return none
+ *****************************************************************************/
+void Adapt_Restore(const Adapt_Retained * state);
+
+#endif /* SRC_ADAPT_H_ */
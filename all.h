@@ -10,5 +10,14 @@
 
 //#define RW_FROM_REGISTER
 #define READ_TEMPERATURE
+#define SI7021_NO_HOLD_MODE         // release the bus and sleep in EM2 during the Si7021 conversion
+#define ISR_TIMING                  // record worst-case ISR execution time (isrtime.h)
+//#define TELEMETRY_BINARY            // send binary frames instead of "+ 23.4C" after reset (?f# at runtime)
+#define TELEMETRY_CRC               // append a CRC-8 to binary frames (?c# at runtime)
+//#define CAPSENSE_LESENSE            // scan the touch pads with LESENSE in EM2, wake only on a touch (capsense.c)
+#if !defined(CAPSENSE_LESENSE_CHANNELS)
+#define CAPSENSE_LESENSE_CHANNELS   { 0, 1, 2, 3 }  // LESENSE channel (LES_CHn pin) of each capsense pad, ACMP_CHANNELS entries in CAPSENSE_CHANNELS order
+#endif
+//#define HIBERNATE_EM4               // hibernate in EM4H between samples of HIBERNATE_MIN_PERIOD_MS or more
 
 #endif /* SRC_ALL_H_ */
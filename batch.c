@@ -0,0 +1,254 @@
+#include "batch.h"
+#include "ldma.h"
+#include "uart.h"
+#include "timer.h"
+#include "tempconv.h"
+#include "rtcc.h"
+
+static Batch_Sample batch_ring[BATCH_MAX_SAMPLES];
+static uint8_t  batch_tail;                         // oldest buffered sample
+static uint8_t  batch_count;
+static uint8_t  batch_size = BATCH_SIZE_DEFAULT;
+static uint32_t batch_deadline_ms = BATCH_DEADLINE_DEFAULT_MS;
+static uint32_t batch_overruns;
+static uint8_t  batch_sequence;                     // sequence number of the next sample
+
+/******************************************************************************
+ * @brief Buffer a measurement. If the ring is full the oldest sample is lost
+ * @param centi = temperature in hundredths, code = raw Si7021 code,
+ *        celsius = unit of centi
+ * @return none
+ *****************************************************************************/
+void Batch_Add(int32_t centi, uint16_t code, bool celsius) {
+    Batch_Sample * sample;
+
+    if (batch_count == BATCH_MAX_SAMPLES) {         // queue stayed full for a whole batch
+        batch_tail = (batch_tail + 1) % BATCH_MAX_SAMPLES;
+        batch_count--;
+        batch_overruns++;
+    }
+    sample = &batch_ring[(batch_tail + batch_count) % BATCH_MAX_SAMPLES];
+    sample->centi   = centi;                        // -46.85 C to 264.80 F, fits 16 bits
+    sample->code    = code;
+    sample->seq     = batch_sequence++;
+    sample->celsius = celsius;
+    sample->time    = RTCC_Now();
+    batch_count++;
+}
+/******************************************************************************
+ * @brief Check whether the buffered samples should be sent now
+ * @param alert = true to flush immediately
+ * @return true on alert, when the batch size is reached or when the oldest
+ *         sample would be older than the latency deadline by the next sample
+ *****************************************************************************/
+bool Batch_Due(bool alert) {
+    uint32_t age_ms;
+
+    if (batch_count == 0) {
+        return false;
+    }
+    if (alert || (batch_count >= batch_size)) {
+        return true;
+    }
+    if (batch_deadline_ms == 0) {
+        return false;
+    }
+    age_ms = RTCC_TICKS_TO_MS(RTCC_Now() - batch_ring[batch_tail].time);
+    return (age_ms + letimer_get_period()) >= batch_deadline_ms;       // checked again one running period from now
+}
+/******************************************************************************
+ * @brief Encode one sample as selected by opts
+ * @param buf = FORMAT_MAX_LEN bytes, sample = measurement, opts = encoding
+ * @return number of bytes written, 0 if the layout is too long
+ *****************************************************************************/
+static uint8_t Batch_Encode(uint8_t * buf, const Batch_Sample * sample, const Format_Options * opts) {
+    Format_Options ascii;
+
+    switch (opts->kind) {
+        case FORMAT_BINARY_RAW:
+            return Format_Binary(buf, FORMAT_MAX_LEN, FRAME_TYPE_RAW, sample->seq, sample->code, opts->crc);
+        case FORMAT_BINARY_FIXED:
+            return Format_Binary(buf, FORMAT_MAX_LEN, sample->celsius ? FRAME_TYPE_CENTI_C : FRAME_TYPE_CENTI_F,
+                                 sample->seq, (uint16_t)sample->centi, opts->crc);
+        default:
+            ascii = *opts;
+            ascii.unit = sample->celsius ? UPPER_C : UPPER_F;   // Send C or F
+            return Format_Fixed(buf, FORMAT_MAX_LEN, sample->centi, &ascii);
+    }
+}
+/******************************************************************************
+ * @brief Send every buffered raw code as one FRAME_TYPE_DELTA frame, a base
+ *        code followed by zig-zag varint differences. The frame may span
+ *        several TX slots, they are chained into one burst
+ * @param crc = append a CRC-8
+ * @return number of samples queued, 0 if the queue has no room for the frame
+ *****************************************************************************/
+static uint8_t Batch_Flush_Delta(bool crc) {
+    uint8_t   frame[BATCH_DELTA_FRAME_MAX];
+    uint8_t   length;
+    uint8_t   sent = batch_count;
+    uint8_t * slot;
+    uint8_t   chunk;
+    Delta_Encoder enc;
+
+    frame[0] = FRAME_SYNC;
+    frame[1] = crc ? (FRAME_TYPE_DELTA | FRAME_TYPE_CRC) : FRAME_TYPE_DELTA;
+    frame[2] = batch_ring[batch_tail].seq;          // the others follow without gaps
+    frame[3] = batch_count;
+    Delta_Encoder_Init(&enc, &frame[BATCH_DELTA_HEADER_LEN], sizeof(frame) - BATCH_DELTA_HEADER_LEN - 1);
+    for (uint8_t i = 0; i < batch_count; i++) {
+        Delta_Encode(&enc, batch_ring[(batch_tail + i) % BATCH_MAX_SAMPLES].code);  // sized for the worst case, always fits
+    }
+    length = BATCH_DELTA_HEADER_LEN + enc.len;
+    if (crc) {
+        frame[length] = Format_CRC8(frame, length);
+        length++;
+    }
+    if ((TX_QUEUE_DEPTH - LDMA_TX_Queue_Depth()) < ((length + TX_SLOT_SIZE - 1) / TX_SLOT_SIZE)) {
+        return 0;                                   // never send part of a frame
+    }
+
+    LDMA_TX_Hold();
+    for (uint8_t pos = 0; pos < length; pos += chunk) {
+        chunk = ((length - pos) > TX_SLOT_SIZE) ? TX_SLOT_SIZE : (length - pos);
+        slot = LDMA_TX_Reserve();
+        for (uint8_t i = 0; i < chunk; i++) {
+            slot[i] = frame[pos + i];
+        }
+        LDMA_TX_Commit(chunk);
+    }
+    LDMA_TX_Release();
+
+    batch_tail = (batch_tail + batch_count) % BATCH_MAX_SAMPLES;
+    batch_count = 0;
+    return sent;
+}
+/******************************************************************************
+ * @brief Encode the buffered samples back to back into TX slots and send
+ *        them as one DMA burst. Samples that don't fit in the queue stay
+ *        buffered for the next flush. FORMAT_BINARY_DELTA sends the whole
+ *        batch as one frame or waits until the queue has room for it
+ * @param opts = telemetry encoding
+ * @return number of samples queued
+ *****************************************************************************/
+uint8_t Batch_Flush(const Format_Options * opts) {
+    uint8_t   frame[FORMAT_MAX_LEN];
+    uint8_t * slot = NULL;
+    uint8_t   used = 0;
+    uint8_t   length;
+    uint8_t   sent = 0;
+
+    if (opts->kind == FORMAT_BINARY_DELTA) {
+        return batch_count ? Batch_Flush_Delta(opts->crc) : 0;
+    }
+    LDMA_TX_Hold();                                 // every slot below goes out in one descriptor chain
+    while (batch_count) {
+        length = Batch_Encode(frame, &batch_ring[batch_tail], opts);
+        if (slot && ((used + length) > TX_SLOT_SIZE)) {
+            LDMA_TX_Commit(used);                   // slot full, frames never straddle two slots
+            slot = NULL;
+        }
+        if (slot == NULL) {
+            if (LDMA_TX_Queue_Depth() == TX_QUEUE_DEPTH) {
+                break;                              // keep the rest for the next flush
+            }
+            slot = LDMA_TX_Reserve();
+            used = 0;
+            if (slot == NULL) {
+                break;
+            }
+        }
+        for (uint8_t i = 0; i < length; i++) {
+            slot[used++] = frame[i];
+        }
+        batch_tail = (batch_tail + 1) % BATCH_MAX_SAMPLES;
+        batch_count--;
+        sent++;
+    }
+    if (slot) {
+        LDMA_TX_Commit(used);
+    }
+    LDMA_TX_Release();
+    return sent;
+}
+/******************************************************************************
+ * @brief Set the number of samples that triggers a flush
+ * @param size = 1 to BATCH_MAX_SAMPLES
+ * @return false if out of range
+ *****************************************************************************/
+bool Batch_Set_Size(uint32_t size) {
+    if ((size == 0) || (size > BATCH_MAX_SAMPLES)) {
+        return false;
+    }
+    batch_size = size;
+    return true;
+}
+/******************************************************************************
+ * @brief Set the latency deadline of a batch
+ * @param deadline_ms = maximum age of the oldest sample, 0 for none
+ * @return none
+ *****************************************************************************/
+void Batch_Set_Deadline(uint32_t deadline_ms) {
+    batch_deadline_ms = deadline_ms;
+}
+/******************************************************************************
+ * @brief Number of samples lost because the ring was full
+ * @param none
+ * @return overrun counter since reset
+ *****************************************************************************/
+uint32_t Batch_Overruns(void) {
+    return batch_overruns;
+}
+/******************************************************************************
+ * @brief Copy the buffered samples, the sequence counter and the flush
+ *        settings out
+ * @param state = destination
+ * @return none
+ *****************************************************************************/
+void Batch_Save(Batch_Retained * state) {
+    const Batch_Sample * sample;
+
+    state->fahrenheit  = 0;
+    state->oldest_time = batch_ring[batch_tail].time;
+    for (uint8_t i = 0; i < batch_count; i++) {
+        sample = &batch_ring[(batch_tail + i) % BATCH_MAX_SAMPLES];
+        state->code[i] = sample->code;
+        if (!sample->celsius) {
+            state->fahrenheit |= (1u << i);
+        }
+    }
+    state->count       = batch_count;
+    state->sequence    = batch_sequence;
+    state->size        = batch_size;
+    state->deadline_ms = batch_deadline_ms;
+}
+/******************************************************************************
+ * @brief Reload samples and settings saved by Batch_Save, e.g. after an EM4
+ *        wakeup. Only the oldest timestamp is kept, every sample gets it, so
+ *        a partial flush afterwards errs towards an early deadline
+ * @param state = source, ignored if its counts are out of range
+ * @return none
+ *****************************************************************************/
+void Batch_Restore(const Batch_Retained * state) {
+    Batch_Sample * sample;
+    uint16_t code;
+
+    if ((state->count > BATCH_MAX_SAMPLES) || (state->size == 0) || (state->size > BATCH_MAX_SAMPLES)) {
+        return;
+    }
+    for (uint8_t i = 0; i < state->count; i++) {
+        sample = &batch_ring[i];
+        code = state->code[i];
+        sample->code    = code;
+        sample->celsius = !(state->fahrenheit & (1u << i));
+        sample->centi   = sample->celsius ? Temp_Code_To_Centi_Celsius(code >> 8, code & 0xFF)
+                                          : Temp_Code_To_Centi_Fahrenheit(code >> 8, code & 0xFF);
+        sample->seq     = state->sequence - state->count + i;   // Batch_Add numbers samples without gaps
+        sample->time    = state->oldest_time;
+    }
+    batch_tail        = 0;
+    batch_count       = state->count;
+    batch_sequence    = state->sequence;
+    batch_size        = state->size;
+    batch_deadline_ms = state->deadline_ms;
+}
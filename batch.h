@@ -0,0 +1,138 @@
+/**************************************************************************//**
+ * @file batch.h
+ * @brief Telemetry sample batching header
+ * @author Silicon Labs
+ * @version 1.00
+ ******************************************************************************
+ * @section License
+ * <b>(C) Copyright 2014 Silicon Labs, http://www.silabs.com</b>
+ *******************************************************************************
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ * DISCLAIMER OF WARRANTY/LIMITATION OF REMEDIES: Silicon Labs has no
+ * obligation to support this Software. Silicon Labs is providing the
+ * Software "AS IS", with no express or implied warranties of any kind,
+ * including, but not limited to, any implied warranties of merchantability
+ * or fitness for any particular purpose or warranties against infringement
+ * of any proprietary rights of a third party.
+ *
+ * Silicon Labs will not be liable for any consequential, incidental, or
+ * special damages, or any other relief, or for any claim by any third party,
+ * arising from your use of this Software.
+ *
+ ******************************************************************************/
+#ifndef SRC_BATCH_H_
+#define SRC_BATCH_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "format.h"
+#include "delta.h"
+
+#define BATCH_MAX_SAMPLES           16      // RAM ring, oldest sample is overwritten when full
+#define BATCH_SIZE_DEFAULT           8      // flush after this many samples (?bN#)
+#define BATCH_DEADLINE_DEFAULT_MS 60000     // flush before the oldest sample is older (?lN#), 0 = no deadline
+
+/* FRAME_TYPE_DELTA: sync, type, sequence of the first sample, count, codes, [CRC-8] */
+#define BATCH_DELTA_HEADER_LEN       4
+#define BATCH_DELTA_FRAME_MAX   (BATCH_DELTA_HEADER_LEN + DELTA_BASE_LEN + ((BATCH_MAX_SAMPLES - 1) * DELTA_VARINT_MAX_LEN) + 1)
+
+/******************************************************************************
+ * @brief One buffered measurement, encoded only when the batch is flushed
+ *****************************************************************************/
+typedef struct {
+    int16_t  centi;                 // hundredths of a degree in the unit below
+    uint16_t code;                  // raw Si7021 code
+    uint8_t  seq;                   // binary frame sequence number, counts every sample
+    bool     celsius;
+    uint32_t time;                  // RTCC timestamp of Batch_Add, for the latency deadline
+} Batch_Sample;
+
+/******************************************************************************
+ * @brief Buffered samples, sequence counter and flush settings, kept across
+ *        EM4 hibernation. Only the raw codes are kept: the temperatures are
+ *        converted again and the sequence numbers follow from the counter
+ *****************************************************************************/
+typedef struct {
+    uint16_t code[BATCH_MAX_SAMPLES];       // oldest sample first
+    uint16_t fahrenheit;                    // bit i set: sample i was in fahrenheit
+    uint8_t  count;
+    uint8_t  sequence;                      // sequence number of the next sample
+    uint8_t  size;
+    uint32_t deadline_ms;
+    uint32_t oldest_time;                   // RTCC timestamp of code[0], the RTCC runs on through EM4H
+} Batch_Retained;
+
+/******************************************************************************
+ * @brief Buffer a measurement. If the ring is full the oldest sample is lost
+ * @param centi = temperature in hundredths, code = raw Si7021 code,
+ *        celsius = unit of centi
+ * @return none
+ *****************************************************************************/
+void Batch_Add(int32_t centi, uint16_t code, bool celsius);
+
+/******************************************************************************
+ * @brief Check whether the buffered samples should be sent now
+ * @param alert = true to flush immediately
+ * @return true on alert, when the batch size is reached or when the oldest
+ *         sample would be older than the latency deadline by the next sample
+ *****************************************************************************/
+bool Batch_Due(bool alert);
+
+/******************************************************************************
+ * @brief Encode the buffered samples back to back into TX slots and send
+ *        them as one DMA burst. Samples that don't fit in the queue stay
+ *        buffered for the next flush. FORMAT_BINARY_DELTA sends the whole
+ *        batch as one frame or waits until the queue has room for it
+ * @param opts = telemetry encoding
+ * @return number of samples queued
+ *****************************************************************************/
+uint8_t Batch_Flush(const Format_Options * opts);
+
+/******************************************************************************
+ * @brief Set the number of samples that triggers a flush
+ * @param size = 1 to BATCH_MAX_SAMPLES
+ * @return false if out of range
+ *****************************************************************************/
+bool Batch_Set_Size(uint32_t size);
+
+/******************************************************************************
+ * @brief Set the latency deadline of a batch
+ * @param deadline_ms = maximum age of the oldest sample, 0 for none
+ * @return none
+ *****************************************************************************/
+void Batch_Set_Deadline(uint32_t deadline_ms);
+
+/******************************************************************************
+ * @brief Number of samples lost because the ring was full
+ * @param none
+ * @return overrun counter since reset
+ *****************************************************************************/
+uint32_t Batch_Overruns(void);
+
+/******************************************************************************
+ * @brief Copy the buffered samples, the sequence counter and the flush
+ *        settings out
+ * @param state = destination
+ * @return none
+ *****************************************************************************/
+void Batch_Save(Batch_Retained * state);
+
+/******************************************************************************
+ * @brief Reload samples and settings saved by Batch_Save, e.g. after an EM4
+ *        wakeup
+ * @param state = source, ignored if its counts are out of range
+ * @return none
+ *****************************************************************************/
+void Batch_Restore(const Batch_Retained * state);
+
+#endif /* SRC_BATCH_H_ */
@@ -20,6 +20,12 @@
 #include "em_cmu.h"
 #include "em_emu.h"
 #include "capsense.h"
+#include "isrtime.h"
+#if defined(CAPSENSE_LESENSE)
+#include "em_core.h"
+#include "em_lesense.h"
+#include "sleep.h"
+#endif
 
 /*******************************************************************************
  * @addtogroup kitdrv
@@ -31,7 +37,8 @@
  * @brief Capacitive sensing driver
  *
  * @details
- *  Capacitive sensing driver using TIMER and ACMP peripherals.
+ *  Capacitive sensing driver using TIMER and ACMP peripherals, or LESENSE
+ *  and ACMP when CAPSENSE_LESENSE is defined.
  *
  * @{
  ******************************************************************************/
@@ -91,8 +98,81 @@ static volatile uint32_t channelValues[ACMP_CHANNELS] = { 0 };
  *****************************************************************************/
 static volatile uint32_t channelMaxValues[ACMP_CHANNELS] = { 0 };
 
+/** Channels CAPSENSE_Sense measures, bit n is channelValues[n]. */
+static volatile uint32_t channelMask = CAPSENSE_ALL_CHANNELS;
+
+#if defined(CAPSENSE_LESENSE)
+#if !defined(LESENSE_PRESENT)
+#error "CAPSENSE_LESENSE needs a device with the LESENSE peripheral"
+#endif
+#if !defined(CAPSENSE_LESENSE_CHANNELS)
+#error "CAPSENSE_LESENSE_CHANNELS must list the LESENSE channel of each pad (all.h or capsenseconfig.h)"
+#endif
+_Static_assert(sizeof((const uint8_t[])CAPSENSE_LESENSE_CHANNELS) == ACMP_CHANNELS,
+               "CAPSENSE_LESENSE_CHANNELS needs one LESENSE channel per ACMP_CHANNELS pad");
+
+#define CAPSENSE_LESENSE_SCAN_HZ            20      /* scans per second in EM2 */
+#define CAPSENSE_LESENSE_SAMPLE_TICKS       0x0F    /* LFACLK cycles the ACMP oscillations are counted */
+#define CAPSENSE_LESENSE_ACMP_THRES         0x38    /* ACMP capsense reference, as ACMP_CAPSENSE_INIT_DEFAULT */
+#define CAPSENSE_LESENSE_CALIBRATION_SCANS  10      /* idle scans before the thresholds are armed */
+#define CAPSENSE_LESENSE_EM_BLOCK           3       /* LFACLK stops in EM3 */
+
+/** LESENSE channel of each capsense channel. */
+static const uint8_t lesenseChannels[ACMP_CHANNELS] = CAPSENSE_LESENSE_CHANNELS;
+/** Interrupt and sensor state bits of lesenseChannels. */
+static uint32_t lesenseChannelMask;
+/** Set once CAPSENSE_Init has started the periodic scan. */
+static bool lesenseStarted;
+/** Scans seen so far during calibration. */
+static volatile uint8_t calibrationScans;
+/** Called on touch threshold crossings. */
+static void (*touchCallback)(void);
+
+/** Counter mode channel: count ACMP oscillations, compare "less than". */
+static LESENSE_ChDesc_TypeDef lesenseChannelConfig = {
+    .enaScanCh     = true,
+    .enaPin        = true,
+    .enaInt        = false,                         /* armed after calibration */
+    .chPinExMode   = lesenseChPinExDis,
+    .chPinIdleMode = lesenseChPinIdleDis,
+    .useAltEx      = false,
+    .shiftRes      = false,
+    .invRes        = false,
+    .storeCntRes   = true,
+    .exClk         = lesenseClkLF,
+    .sampleClk     = lesenseClkLF,
+    .exTime        = 0,
+    .sampleDelay   = CAPSENSE_LESENSE_SAMPLE_TICKS,
+    .measDelay     = 0,
+    .acmpThres     = CAPSENSE_LESENSE_ACMP_THRES,
+    .sampleMode    = lesenseSampleModeCounter,
+    .intMode       = lesenseSetIntNone,
+    .cntThres      = 0,
+    .compMode      = lesenseCompModeLess,
+};
+#else
+/******************************************************************************
+ * @brief The measurement window is TIMER0 TOP + 1 periods of HFPERCLK / 512.
+ *        Each channel uses the shortest TOP whose idle counts still leave
+ *        CAPSENSE_WINDOW_SNR times their spread below the press threshold.
+ *****************************************************************************/
+#if !defined(CAPSENSE_WINDOW_MAX_TOP)
+#define CAPSENSE_WINDOW_MAX_TOP         10      /* the original fixed window */
+#endif
+#define CAPSENSE_WINDOW_MIN_TOP         1
+#define CAPSENSE_WINDOW_SAMPLES         8       /* idle measurements per candidate window */
+#define CAPSENSE_WINDOW_SNR             4       /* press margin over idle spread */
+#define CAPSENSE_WINDOW_RETUNE_SWEEPS   600     /* CAPSENSE_Sense calls between re-tunes */
+
+/** TIMER0 TOP used for each channel. */
+static uint16_t channelTop[ACMP_CHANNELS];
+/** CAPSENSE_Sense calls since the windows were last tuned. */
+static uint16_t sweepsSinceTune;
+#endif
+
 /** @endcond */
 
+#if !defined(CAPSENSE_LESENSE)
 /******************************************************************************
  * @brief
  *   TIMER0 interrupt handler.
@@ -105,6 +185,7 @@ static volatile uint32_t channelMaxValues[ACMP_CHANNELS] = { 0 };
  *****************************************************************************/
 void TIMER0_IRQHandler(void)
 {
+    ISR_TIMING_START();
     uint32_t count;
 
     /* Stop timers */
@@ -126,7 +207,9 @@ void TIMER0_IRQHandler(void)
     }
 
     measurementComplete = true;
+    ISR_TIMING_END(ISR_TIMER0);
 }
+#endif
 
 /******************************************************************************
  * @brief Get the current channelValue for a channel
@@ -222,16 +305,218 @@ int32_t CAPSENSE_getSliderPosition(void) {
     return position;
 }
 
+#if defined(CAPSENSE_LESENSE)
+/******************************************************************************
+ * @brief
+ *   Copy the latest LESENSE counts into channelValues.
+ *
+ * @details
+ *   The counts are stored by the hardware on every scan, this only makes
+ *   them visible to the getters shared with the TIMER backend.
+ *****************************************************************************/
+static void CAPSENSE_Refresh(void)
+{
+    uint32_t count;
+
+    for (int i = 0; i < ACMP_CHANNELS; i++) {
+        if (!(channelMask & (1UL << i))) {
+            continue;
+        }
+        count = LESENSE_ScanResultDataBufferGet(lesenseChannels[i]);
+        channelValues[i] = count;
+        if (count > channelMaxValues[i]) {
+            channelMaxValues[i] = count;
+        }
+    }
+}
+
+/******************************************************************************
+ * @brief
+ *   Scan the channels in channelMask and restart calibration.
+ *
+ * @details
+ *   Thresholds only come from idle counts, so every change of the mask
+ *   starts over with CAPSENSE_LESENSE_CALIBRATION_SCANS untouched scans.
+ *****************************************************************************/
+static void CAPSENSE_Calibrate(void)
+{
+    bool enabled;
+
+    LESENSE_IntDisable(_LESENSE_IEN_MASK);
+    lesenseChannelConfig.enaInt  = false;
+    lesenseChannelConfig.intMode = lesenseSetIntNone;
+    lesenseChannelMask = 0;
+    for (int i = 0; i < ACMP_CHANNELS; i++) {
+        enabled = (channelMask & (1UL << i)) != 0;
+        channelMaxValues[i] = 0;
+        lesenseChannelConfig.enaScanCh = enabled;
+        lesenseChannelConfig.enaPin    = enabled;
+        LESENSE_ChannelConfig(&lesenseChannelConfig, lesenseChannels[i]);
+        if (enabled) {
+            lesenseChannelMask |= (1UL << lesenseChannels[i]);
+        }
+    }
+
+    calibrationScans = 0;
+    LESENSE_IntClear(_LESENSE_IFC_MASK);
+    LESENSE_IntEnable(LESENSE_IEN_SCANCOMPLETE);
+}
+
+/******************************************************************************
+ * @brief
+ *   Arm the compare of every selected channel after calibration.
+ *
+ * @details
+ *   A channel sets its interrupt flag on every scan while its count is
+ *   below the threshold, 25 % under the idle maximum like
+ *   CAPSENSE_getPressed.
+ *****************************************************************************/
+static void CAPSENSE_ArmThresholds(void)
+{
+    for (int i = 0; i < ACMP_CHANNELS; i++) {
+        if (!(channelMask & (1UL << i))) {
+            continue;
+        }
+        lesenseChannelConfig.enaScanCh = true;
+        lesenseChannelConfig.enaPin    = true;
+        lesenseChannelConfig.enaInt    = true;
+        lesenseChannelConfig.intMode   = lesenseSetIntLevel;
+        lesenseChannelConfig.cntThres  = channelMaxValues[i] - (channelMaxValues[i] >> 2);
+        LESENSE_ChannelConfig(&lesenseChannelConfig, lesenseChannels[i]);
+    }
+}
+
+/******************************************************************************
+ * @brief
+ *   LESENSE interrupt handler.
+ *
+ * @details
+ *   While calibrating, every scan complete interrupt updates the idle
+ *   maximums. Afterwards a channel interrupt means a pad is touched: scan
+ *   complete is enabled until no pad is below its threshold any more, so
+ *   the release is seen as well, and the callback runs for each.
+ *****************************************************************************/
+void LESENSE_IRQHandler(void)
+{
+    ISR_TIMING_START();
+    uint32_t flags = LESENSE_IntGetEnabled();
+
+    LESENSE_IntClear(flags);
+    CAPSENSE_Refresh();
+
+    if (calibrationScans < CAPSENSE_LESENSE_CALIBRATION_SCANS) {
+        if (++calibrationScans == CAPSENSE_LESENSE_CALIBRATION_SCANS) {
+            LESENSE_IntDisable(LESENSE_IEN_SCANCOMPLETE);
+            CAPSENSE_ArmThresholds();
+            LESENSE_IntEnable(lesenseChannelMask);
+        }
+    }
+    else {
+        if (flags & lesenseChannelMask) {
+            LESENSE_IntEnable(LESENSE_IEN_SCANCOMPLETE);    /* watch for the release */
+        }
+        else if (!(LESENSE_SensorStatusGet() & lesenseChannelMask)) {
+            LESENSE_IntDisable(LESENSE_IEN_SCANCOMPLETE);   /* all released, back to threshold interrupts only */
+        }
+        if (touchCallback != NULL) {
+            touchCallback();
+        }
+    }
+    ISR_TIMING_END(ISR_LESENSE);
+}
+
+/******************************************************************************
+ * @brief Register a function to call when a pad crosses its touch threshold
+ * @param callback Called from LESENSE_IRQHandler, NULL to remove.
+ *****************************************************************************/
+void CAPSENSE_setCallback(void (*callback)(void))
+{
+    touchCallback = callback;
+}
+
+/******************************************************************************
+ * @brief Select the channels LESENSE scans, recalibrating them
+ * @param mask Bit n selects channel n, bits beyond ACMP_CHANNELS are ignored.
+ *****************************************************************************/
+void CAPSENSE_setChannelMask(uint32_t mask)
+{
+    CORE_DECLARE_IRQ_STATE;
+
+    CORE_ENTER_CRITICAL();
+    channelMask = mask & CAPSENSE_ALL_CHANNELS;
+    if (lesenseStarted) {
+        CAPSENSE_Calibrate();
+    }
+    CORE_EXIT_CRITICAL();
+}
+
+/******************************************************************************
+ * @brief
+ *   Make the latest counts available to the getters.
+ *
+ * @details
+ *   LESENSE measures all channels by itself in EM2, so no measurement is
+ *   started here and the core does not enter EM1.
+ *****************************************************************************/
+void CAPSENSE_Sense(void)
+{
+    CAPSENSE_Refresh();
+}
+
+/******************************************************************************
+ * @brief
+ *   Initializes the capacitive sense system.
+ *
+ * @details
+ *   LESENSE duty cycles ACMP_CAPSENSE in cap-sense (oscillator mode) and
+ *   counts its oscillations on every channel at CAPSENSE_LESENSE_SCAN_HZ.
+ *   The first CAPSENSE_LESENSE_CALIBRATION_SCANS scans record the idle
+ *   counts, after which the CPU is only interrupted by touches.
+ *****************************************************************************/
+void CAPSENSE_Init(void)
+{
+    ACMP_CapsenseInit_TypeDef capsenseInit = ACMP_CAPSENSE_INIT_DEFAULT;
+    LESENSE_Init_TypeDef lesenseInit = LESENSE_INIT_DEFAULT;
+
+    CMU_ClockEnable(cmuClock_HFPER, true);
+#if defined(ACMP_CAPSENSE_CMUCLOCK)
+    CMU_ClockEnable(ACMP_CAPSENSE_CMUCLOCK, true);
+#else
+    CMU->HFPERCLKEN0 |= ACMP_CAPSENSE_CLKEN;
+#endif
+    CMU_ClockEnable(cmuClock_LESENSE, true);        /* LFACLK, already running for the LETIMER */
+
+    /* ACMP is enabled and its input selected by LESENSE for every sample */
+    capsenseInit.enable = false;
+    ACMP_CapsenseInit(ACMP_CAPSENSE, &capsenseInit);
+
+    lesenseInit.coreCtrl.scanStart    = lesenseScanStartPeriodic;
+    lesenseInit.coreCtrl.bufOverWr    = true;       /* keep only the latest count of each channel */
+    lesenseInit.coreCtrl.storeScanRes = false;
+    lesenseInit.perCtrl.warmupMode    = lesenseWarmupModeNormal;
+    LESENSE_Init(&lesenseInit, true);
+
+    LESENSE_ClkDivSet(lesenseClkLF, lesenseClkDiv_1);
+    LESENSE_ScanFreqSet(0, CAPSENSE_LESENSE_SCAN_HZ);
+
+    CAPSENSE_Calibrate();
+    Sleep_Block_Mode(CAPSENSE_LESENSE_EM_BLOCK);
+    NVIC_EnableIRQ(LESENSE_IRQn);
+    LESENSE_ScanStart();
+    lesenseStarted = true;
+}
+#else
 /******************************************************************************
  * @brief
  *   Start a capsense measurement of a specific channel and waits for
- *   it to complete.
+ *   it to complete. The window is the one tuned for currentChannel.
  *****************************************************************************/
 static void CAPSENSE_Measure(ACMP_Channel_TypeDef channel) {
     /* Set up this channel in the ACMP. */
     ACMP_CapsenseChannelSet(ACMP_CAPSENSE, channel);
 
     /* Reset timers */
+    TIMER0->TOP = channelTop[currentChannel];
     TIMER0->CNT = 0;
     TIMER1->CNT = 0;
 
@@ -249,30 +534,129 @@ static void CAPSENSE_Measure(ACMP_Channel_TypeDef channel) {
 
 /******************************************************************************
  * @brief
- *   This function iterates through all the capsensors and reads and
- *   initiates a reading. Uses EM1 while waiting for the result from
- *   each sensor.
+ *   Check whether a channel index is in use and selected.
  *****************************************************************************/
-void CAPSENSE_Sense(void) {
-    /* Use the default STK capacative sensing setup and enable it */
-    ACMP_Enable(ACMP_CAPSENSE);
+static bool CAPSENSE_Selected(uint8_t index, uint32_t mask) {
+    if (!(mask & (1UL << index))) {
+        return false;
+    }
+#if defined(CAPSENSE_CHANNELS)
+    return true;
+#else
+    return channelsInUse[index];
+#endif
+}
 
+/******************************************************************************
+ * @brief
+ *   ACMP input measured for a channel index.
+ *****************************************************************************/
+static ACMP_Channel_TypeDef CAPSENSE_AcmpChannel(uint8_t index) {
 #if defined(CAPSENSE_CHANNELS)
-    /* Iterate through only the channels in the channelList */
+    return channelList[index];
+#else
+    return (ACMP_Channel_TypeDef) index;
+#endif
+}
+
+/******************************************************************************
+ * @brief
+ *   Pick the shortest measurement window for each selected channel.
+ *
+ * @details
+ *   A press lowers the count by a quarter of the idle maximum, see
+ *   CAPSENSE_getPressed. Windows are tried from CAPSENSE_WINDOW_MIN_TOP,
+ *   doubling, and the first whose idle minimum / 4 is at least
+ *   CAPSENSE_WINDOW_SNR times the idle spread (plus one count of
+ *   quantization) is kept. CAPSENSE_WINDOW_MAX_TOP is the fallback. The
+ *   count scale changes with the window, so the channel maximum restarts
+ *   from the samples of the chosen one. The ACMP must be enabled.
+ *****************************************************************************/
+static void CAPSENSE_TuneWindows(uint32_t mask) {
+    uint32_t count, low, high;
+    uint16_t top;
+
     for (currentChannel = 0; currentChannel < ACMP_CHANNELS; currentChannel++) {
-        CAPSENSE_Measure(channelList[currentChannel]);
+        if (!CAPSENSE_Selected(currentChannel, mask)) {
+            continue;
+        }
+
+        top = CAPSENSE_WINDOW_MIN_TOP;
+        while (1) {
+            channelTop[currentChannel] = top;
+            low  = UINT32_MAX;
+            high = 0;
+            for (int n = 0; n < CAPSENSE_WINDOW_SAMPLES; n++) {
+                CAPSENSE_Measure(CAPSENSE_AcmpChannel(currentChannel));
+                count = channelValues[currentChannel];
+                low  = (count < low)  ? count : low;
+                high = (count > high) ? count : high;
+            }
+            if (top >= CAPSENSE_WINDOW_MAX_TOP
+                || (low >> 2) >= CAPSENSE_WINDOW_SNR * (high - low + 1)) {
+                break;
+            }
+            top = (top * 2 < CAPSENSE_WINDOW_MAX_TOP) ? top * 2 : CAPSENSE_WINDOW_MAX_TOP;
+        }
+        channelMaxValues[currentChannel] = high;
     }
-#else
-    /* Iterate through all channels and check which channel is in use */
+    sweepsSinceTune = 0;
+}
+
+/******************************************************************************
+ * @brief
+ *   Check whether any selected channel is pressed.
+ *****************************************************************************/
+static bool CAPSENSE_AnyPressed(uint32_t mask) {
+    for (uint8_t i = 0; i < ACMP_CHANNELS; i++) {
+        if (CAPSENSE_Selected(i, mask) && CAPSENSE_getPressed(i)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/******************************************************************************
+ * @brief Select the channels CAPSENSE_Sense measures
+ * @param mask Bit n selects channel n, bits beyond ACMP_CHANNELS are ignored.
+ *****************************************************************************/
+void CAPSENSE_setChannelMask(uint32_t mask) {
+    channelMask = mask & CAPSENSE_ALL_CHANNELS;
+}
+
+/******************************************************************************
+ * @brief
+ *   This function iterates through the capsensors selected by
+ *   CAPSENSE_setChannelMask and reads and initiates a reading. Uses EM1
+ *   while waiting for the result from each sensor. Every
+ *   CAPSENSE_WINDOW_RETUNE_SWEEPS calls the windows are tuned again,
+ *   postponed while a channel is pressed.
+ *****************************************************************************/
+void CAPSENSE_Sense(void) {
+    uint32_t mask = channelMask;
+
+    /* Nothing selected, leave the ACMP off */
+    if (mask == 0) {
+        return;
+    }
+
+    /* Use the default STK capacative sensing setup and enable it */
+    ACMP_Enable(ACMP_CAPSENSE);
+
+    /* Iterate through the channels in use and selected */
     for (currentChannel = 0; currentChannel < ACMP_CHANNELS; currentChannel++) {
-        /* If this channel is not in use, skip to the next one */
-        if (!channelsInUse[currentChannel]) {
+        if (!CAPSENSE_Selected(currentChannel, mask)) {
             continue;
         }
 
-        CAPSENSE_Measure((ACMP_Channel_TypeDef) currentChannel);
+        CAPSENSE_Measure(CAPSENSE_AcmpChannel(currentChannel));
     }
-#endif
+
+    /* Follow drift of the idle counts, never while a touch would skew them */
+    if (++sweepsSinceTune >= CAPSENSE_WINDOW_RETUNE_SWEEPS && !CAPSENSE_AnyPressed(mask)) {
+        CAPSENSE_TuneWindows(mask);
+    }
+
     /* Disable ACMP while not sensing to reduce power consumption */
     ACMP_Disable(ACMP_CAPSENSE);
 }
@@ -286,7 +670,8 @@ void CAPSENSE_Sense(void) {
  *   ACMP is set up in cap-sense (oscillator mode).
  *   TIMER1 counts the number of pulses generated by ACMP_CAPSENSE.
  *   When TIMER0 expires it generates an interrupt.
- *   The number of pulses counted by TIMER1 is then stored in channelValues
+ *   The number of pulses counted by TIMER1 is then stored in channelValues.
+ *   The TIMER0 window of each selected channel is tuned before returning.
  *****************************************************************************/
 void CAPSENSE_Init(void) {
     /* Use the default STK capacative sensing setup */
@@ -303,9 +688,9 @@ void CAPSENSE_Init(void) {
 #endif
     CMU_ClockEnable(cmuClock_PRS, true);
 
-    /* Initialize TIMER0 - Prescaler 2^9, top value 10, interrupt on overflow */
+    /* Initialize TIMER0 - Prescaler 2^9, top value per channel, interrupt on overflow */
     TIMER0->CTRL = TIMER_CTRL_PRESC_DIV512;
-    TIMER0->TOP  = 10;
+    TIMER0->TOP  = CAPSENSE_WINDOW_MAX_TOP;
     TIMER0->IEN  = TIMER_IEN_OF;
     TIMER0->CNT  = 0;
 
@@ -330,7 +715,16 @@ void CAPSENSE_Init(void) {
 
     /* Enable TIMER0 interrupt */
     NVIC_EnableIRQ(TIMER0_IRQn);
+
+    /* Start every channel on the longest window, then shorten the selected ones */
+    for (int i = 0; i < ACMP_CHANNELS; i++) {
+        channelTop[i] = CAPSENSE_WINDOW_MAX_TOP;
+    }
+    ACMP_Enable(ACMP_CAPSENSE);
+    CAPSENSE_TuneWindows(channelMask);
+    ACMP_Disable(ACMP_CAPSENSE);
 }
+#endif
 
 /** @} (end group CapSense) */
 /** @} (end group kitdrv) */
@@ -18,6 +18,7 @@
 #define SRC_CAPSENSE_H_
 
 #include <capsenseconfig.h>
+#include "all.h"
 
 /******************************************************************************
  * @brief Get the current channelValue for a channel
@@ -50,9 +51,11 @@ int32_t CAPSENSE_getSliderPosition(void);
 
 /******************************************************************************
  * @brief
- *   This function iterates through all the capsensors and reads and
- *   initiates a reading. Uses EM1 while waiting for the result from
- *   each sensor.
+ *   This function iterates through the capsensors selected by
+ *   CAPSENSE_setChannelMask and reads and initiates a reading. Uses EM1
+ *   while waiting for the result from each sensor. Every
+ *   CAPSENSE_WINDOW_RETUNE_SWEEPS calls the windows are tuned again,
+ *   postponed while a channel is pressed.
  *****************************************************************************/
 void CAPSENSE_Sense(void);
 /******************************************************************************
@@ -64,9 +67,39 @@ void CAPSENSE_Sense(void);
  *   ACMP is set up in cap-sense (oscillator mode).
  *   TIMER1 counts the number of pulses generated by ACMP_CAPSENSE.
  *   When TIMER0 expires it generates an interrupt.
- *   The number of pulses counted by TIMER1 is then stored in channelValues
+ *   The number of pulses counted by TIMER1 is then stored in channelValues.
+ *   The TIMER0 window of each selected channel is tuned before returning.
  *****************************************************************************/
 void CAPSENSE_Init(void);
 
+/** Channel mask selecting every channel, the default after reset. */
+#define CAPSENSE_ALL_CHANNELS   ((uint32_t)((1ULL << ACMP_CHANNELS) - 1))
+
+/******************************************************************************
+ * @brief
+ *   Select the channels CAPSENSE_Sense measures.
+ *
+ * @details
+ *   Bit n selects channel n as passed to CAPSENSE_getVal. Channels left out
+ *   keep their last value, so the slider needs all NUM_SLIDER_CHANNELS.
+ *   Bits beyond ACMP_CHANNELS are ignored.
+ *
+ * @param mask
+ *   Channels to measure, CAPSENSE_ALL_CHANNELS for all of them.
+ *****************************************************************************/
+void CAPSENSE_setChannelMask(uint32_t mask);
+
+#if defined(CAPSENSE_LESENSE)
+/******************************************************************************
+ * @brief
+ *   Register a function to call when a pad crosses its touch threshold.
+ *
+ * @details
+ *   Runs in LESENSE_IRQHandler on a press, on every scan while a pad is
+ *   held and once on the release, so it should only post work.
+ *****************************************************************************/
+void CAPSENSE_setCallback(void (*callback)(void));
+#endif
+
 
 #endif /* SRC_CAPSENSE_H_ */
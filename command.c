@@ -0,0 +1,368 @@
+#include "command.h"
+#include "uart.h"
+#include "ldma.h"
+#include "main.h"
+#include "timer.h"
+#include "i2ctemp.h"
+#include "isrtime.h"
+#include "batch.h"
+#include "report.h"
+#include "adapt.h"
+#include "sleep.h"
+
+#define COMMAND_INDEX(letter)   ((letter) - 'a')
+
+extern volatile bool isCelsius;
+extern Format_Options tx_format;
+extern Report_Mode report_mode;
+
+static Parse_State parse_state = PARSE_IDLE;
+static uint8_t frame[COMMAND_MAX_LEN];
+static uint8_t frame_len;
+
+/******************************************************************************
+ * @brief ?dC# / ?dF#: temperature unit
+ * @param arg->c = 'C' or 'F' (either case)
+ * @return false for any other unit
+ *****************************************************************************/
+static bool Command_Unit(const Command_Arg * arg, uint32_t * value) {
+    if ((arg->c == LOWER_C) || (arg->c == UPPER_C)) {
+        isCelsius = true;
+        return true;
+    }
+    if ((arg->c == LOWER_F) || (arg->c == UPPER_F)) {
+        isCelsius = false;
+        return true;
+    }
+    return false;
+}
+/******************************************************************************
+ * @brief ?pN#: sample period, the floor while the period is adaptive
+ * @param arg->u = period in milliseconds
+ * @return false if out of range (see letimer_set_period)
+ *****************************************************************************/
+static bool Command_Period(const Command_Arg * arg, uint32_t * value) {
+    return Adapt_Set_Floor(arg->u);
+}
+/******************************************************************************
+ * @brief ?rN#: sensor resolution, applied from the next measurement on
+ * @param arg->u = 11 to 14 bits
+ * @return false for an unsupported resolution
+ *****************************************************************************/
+static bool Command_Resolution(const Command_Arg * arg, uint32_t * value) {
+    return Temp_Set_Resolution(arg->u);
+}
+/******************************************************************************
+ * @brief ?oN#: output format, number of decimals in the telemetry frame
+ * @param arg->u = 0 to FORMAT_MAX_DECIMALS
+ * @return false if out of range
+ *****************************************************************************/
+static bool Command_Output(const Command_Arg * arg, uint32_t * value) {
+    if (arg->u > FORMAT_MAX_DECIMALS) {
+        return false;
+    }
+    tx_format.decimals = arg->u;
+    return true;
+}
+/******************************************************************************
+ * @brief ?fN#: telemetry encoding, ASCII (legacy) or a binary frame
+ * @param arg->u = Format_Kind
+ * @return false for an unknown encoding
+ *****************************************************************************/
+static bool Command_Frame(const Command_Arg * arg, uint32_t * value) {
+    if (arg->u >= FORMAT_KIND_COUNT) {
+        return false;
+    }
+    tx_format.kind = (Format_Kind)arg->u;
+    return true;
+}
+/******************************************************************************
+ * @brief ?cN#: CRC-8 on binary frames
+ * @param arg->u = 0 off, 1 on
+ * @return false for any other value
+ *****************************************************************************/
+static bool Command_CRC(const Command_Arg * arg, uint32_t * value) {
+    if (arg->u > 1) {
+        return false;
+    }
+    tx_format.crc = arg->u;
+    return true;
+}
+/******************************************************************************
+ * @brief ?mN#: report mode
+ * @param arg->u = Report_Mode
+ * @return false for an unknown mode
+ *****************************************************************************/
+static bool Command_Mode(const Command_Arg * arg, uint32_t * value) {
+    if (arg->u >= REPORT_MODE_COUNT) {
+        return false;
+    }
+    if ((report_mode == REPORT_BATCH) && (arg->u != REPORT_BATCH)) {
+        Batch_Flush(&tx_format);                        // don't leave samples behind
+    }
+    report_mode = (Report_Mode)arg->u;
+    return true;
+}
+/******************************************************************************
+ * @brief ?bN#: samples per batch
+ * @param arg->u = 1 to BATCH_MAX_SAMPLES
+ * @return false if out of range
+ *****************************************************************************/
+static bool Command_Batch_Size(const Command_Arg * arg, uint32_t * value) {
+    return Batch_Set_Size(arg->u);
+}
+/******************************************************************************
+ * @brief ?lN#: batch latency deadline
+ * @param arg->u = milliseconds, 0 for none
+ * @return true
+ *****************************************************************************/
+static bool Command_Batch_Deadline(const Command_Arg * arg, uint32_t * value) {
+    Batch_Set_Deadline(arg->u);
+    return true;
+}
+/******************************************************************************
+ * @brief ?sN#: query a statistic, the value is sent with the acknowledgement
+ * @param arg->u = STAT_* index
+ * @return false for an unknown index
+ *****************************************************************************/
+static bool Command_Stats(const Command_Arg * arg, uint32_t * value) {
+    if (arg->u == STAT_TX_DROPS) {
+        *value = LDMA_TX_Drops();
+    }
+    else if (arg->u == STAT_TX_DEPTH) {
+        *value = LDMA_TX_Queue_Depth();
+    }
+    else if (arg->u == STAT_BATCH_OVERRUNS) {
+        *value = Batch_Overruns();
+    }
+    else if ((arg->u >= STAT_ISR_BASE) && (arg->u < (STAT_ISR_BASE + ISR_COUNT))) {
+        *value = ISR_Timing_Max((ISR_Id)(arg->u - STAT_ISR_BASE));
+    }
+    else if ((arg->u >= STAT_SLEEP_RESIDENCY) && (arg->u < (STAT_SLEEP_RESIDENCY + MAX_NUM_SLEEP_MODES))) {
+        *value = Sleep_Residency_ms(arg->u - STAT_SLEEP_RESIDENCY);
+    }
+    else if ((arg->u >= STAT_SLEEP_WAKEUPS) && (arg->u < (STAT_SLEEP_WAKEUPS + MAX_NUM_SLEEP_MODES))) {
+        *value = Sleep_Wakeups(arg->u - STAT_SLEEP_WAKEUPS);
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+/******************************************************************************
+ * @brief ?aN#: report alert threshold
+ * @param arg->i = hundredths of a degree celsius, may be negative
+ * @return true
+ *****************************************************************************/
+static bool Command_Alert(const Command_Arg * arg, uint32_t * value) {
+    Report_Set_Alert(arg->i);
+    return true;
+}
+/******************************************************************************
+ * @brief ?eN#: report deadband
+ * @param arg->u = hundredths of a degree celsius
+ * @return true
+ *****************************************************************************/
+static bool Command_Deadband(const Command_Arg * arg, uint32_t * value) {
+    Report_Set_Deadband(arg->u);
+    return true;
+}
+/******************************************************************************
+ * @brief ?hN#: report heartbeat
+ * @param arg->u = milliseconds, 0 for none
+ * @return true
+ *****************************************************************************/
+static bool Command_Heartbeat(const Command_Arg * arg, uint32_t * value) {
+    Report_Set_Heartbeat(arg->u);
+    return true;
+}
+/******************************************************************************
+ * @brief ?yN#: alert hysteresis
+ * @param arg->u = hundredths of a degree celsius
+ * @return true
+ *****************************************************************************/
+static bool Command_Hysteresis(const Command_Arg * arg, uint32_t * value) {
+    Report_Set_Hysteresis(arg->u);
+    return true;
+}
+/******************************************************************************
+ * @brief ?vN#: adaptive sample period
+ * @param arg->u = 0 fixed period, 1 adaptive
+ * @return false for any other value
+ *****************************************************************************/
+static bool Command_Adaptive(const Command_Arg * arg, uint32_t * value) {
+    if (arg->u > 1) {
+        return false;
+    }
+    Adapt_Enable(arg->u);
+    return true;
+}
+/******************************************************************************
+ * @brief ?uN#: longest adaptive period
+ * @param arg->u = milliseconds
+ * @return false if out of range
+ *****************************************************************************/
+static bool Command_Ceiling(const Command_Arg * arg, uint32_t * value) {
+    return Adapt_Set_Ceiling(arg->u);
+}
+/******************************************************************************
+ * @brief ?tN#: rate of change that shortens the adaptive period
+ * @param arg->u = hundredths of a degree celsius per minute
+ * @return false above ADAPT_RATE_MAX
+ *****************************************************************************/
+static bool Command_Rate(const Command_Arg * arg, uint32_t * value) {
+    return Adapt_Set_Rate(arg->u);
+}
+
+/* add a command by adding its entry, the letter is the index */
+static const Command_Entry command_table[COMMAND_TABLE_SIZE] = {
+    [COMMAND_INDEX('a')] = { ARG_INT,  false, Command_Alert          },
+    [COMMAND_INDEX('b')] = { ARG_UINT, false, Command_Batch_Size     },
+    [COMMAND_INDEX('c')] = { ARG_UINT, false, Command_CRC            },
+    [COMMAND_INDEX('d')] = { ARG_CHAR, false, Command_Unit           },
+    [COMMAND_INDEX('e')] = { ARG_UINT, false, Command_Deadband       },
+    [COMMAND_INDEX('f')] = { ARG_UINT, false, Command_Frame          },
+    [COMMAND_INDEX('h')] = { ARG_UINT, false, Command_Heartbeat      },
+    [COMMAND_INDEX('l')] = { ARG_UINT, false, Command_Batch_Deadline },
+    [COMMAND_INDEX('m')] = { ARG_UINT, false, Command_Mode           },
+    [COMMAND_INDEX('o')] = { ARG_UINT, false, Command_Output         },
+    [COMMAND_INDEX('p')] = { ARG_UINT, false, Command_Period         },
+    [COMMAND_INDEX('r')] = { ARG_UINT, false, Command_Resolution     },
+    [COMMAND_INDEX('s')] = { ARG_UINT, true,  Command_Stats          },
+    [COMMAND_INDEX('t')] = { ARG_UINT, false, Command_Rate           },
+    [COMMAND_INDEX('u')] = { ARG_UINT, false, Command_Ceiling        },
+    [COMMAND_INDEX('v')] = { ARG_UINT, false, Command_Adaptive       },
+    [COMMAND_INDEX('y')] = { ARG_UINT, false, Command_Hysteresis     },
+};
+
+/******************************************************************************
+ * @brief Parse 1 to COMMAND_MAX_DIGITS decimal digits
+ * @param digits = text, len = its length, value = parsed number
+ * @return false if empty, too long or not a number
+ *****************************************************************************/
+static bool Command_Parse_Uint(const uint8_t * digits, uint8_t len, uint32_t * value) {
+    if ((len == 0) || (len > COMMAND_MAX_DIGITS)) {
+        return false;
+    }
+    *value = 0;
+    for (uint8_t i = 0; i < len; i++) {
+        if ((digits[i] < ASCII_OFFSET) || (digits[i] > ASCII_OFFSET + 9)) {
+            return false;
+        }
+        *value = (*value * 10) + (digits[i] - ASCII_OFFSET);
+    }
+    return true;
+}
+/******************************************************************************
+ * @brief Parse the argument of a frame as the entry says
+ * @param entry = command, body = bytes after the letter, len = their count,
+ *        arg = parsed value
+ * @return false if the argument does not match its type
+ *****************************************************************************/
+static bool Command_Parse_Arg(const Command_Entry * entry, const uint8_t * body, uint8_t len, Command_Arg * arg) {
+    switch (entry->arg_type) {
+        case ARG_NONE:
+            return (len == 0);
+        case ARG_CHAR:
+            arg->c = body[0];
+            return (len == 1);
+        case ARG_INT:
+            if ((len > 0) && (body[0] == NEGATIVE_SIGN)) {
+                if (!Command_Parse_Uint(&body[1], len - 1, &arg->u)) {
+                    return false;
+                }
+                arg->i = -(int32_t)arg->u;              // 9 digits, can't overflow
+                return true;
+            }
+            return Command_Parse_Uint(body, len, &arg->u);
+        case ARG_UINT:
+            return Command_Parse_Uint(body, len, &arg->u);
+        default:
+            return false;
+    }
+}
+/******************************************************************************
+ * @brief Look up the frame in command_table, run it and queue the reply
+ * @param valid = false if the frame overflowed
+ * @return none
+ *****************************************************************************/
+static void Command_Dispatch(bool valid) {
+    uint8_t reply[COMMAND_REPLY_LEN];
+    uint8_t reply_len = 0;
+    uint8_t letter = (frame_len > 0) ? (frame[0] | 0x20) : QUESTION_MARK;    // fold to lower case
+    const Command_Entry * entry = NULL;
+    Command_Arg arg;
+    uint32_t value = 0;
+    bool ok = false;
+
+    if ((letter >= 'a') && (letter <= 'z')) {
+        entry = &command_table[COMMAND_INDEX(letter)];
+    }
+    else {
+        letter = QUESTION_MARK;                                                 // unknown: "!?E"
+    }
+    if (valid && entry && entry->handler
+            && Command_Parse_Arg(entry, &frame[1], frame_len - 1, &arg)) {
+        ok = entry->handler(&arg, &value);
+    }
+
+    reply[reply_len++] = EXCLAMATION_MARK;
+    reply[reply_len++] = letter;
+    reply[reply_len++] = ok ? UPPER_K : UPPER_E;
+    if (ok && entry->returns_value) {
+        reply_len += Format_Uint(&reply[reply_len], sizeof(reply) - reply_len, value);
+    }
+    LDMA_TX_Enqueue(reply, reply_len);
+}
+/******************************************************************************
+ * @brief Feed one received byte through the parser, a complete frame is
+ *        dispatched and acknowledged right away
+ * @param byte = next byte of the LEUART stream
+ * @return true if this byte completed a frame
+ *****************************************************************************/
+bool Command_Parse_Byte(uint8_t byte) {
+    if (byte == QUESTION_MARK) {                        // start frame, whatever came before is stale
+        parse_state = PARSE_FRAME;
+        frame_len = 0;
+        return false;
+    }
+    switch (parse_state) {
+        case PARSE_FRAME:
+            if (byte == HASHTAG) {
+                Command_Dispatch(true);
+                parse_state = PARSE_IDLE;
+                return true;
+            }
+            if (frame_len < COMMAND_MAX_LEN) {
+                frame[frame_len++] = byte;
+            }
+            else {
+                parse_state = PARSE_OVERFLOW;
+            }
+            break;
+        case PARSE_OVERFLOW:
+            if (byte == HASHTAG) {
+                Command_Dispatch(false);
+                parse_state = PARSE_IDLE;
+                return true;
+            }
+            break;
+        default:
+            break;                                      // outside a frame
+    }
+    return false;
+}
+
+/******************************************************************************
+ * @brief Consume the bytes received since the last call and apply every
+ *        command found. Runs from the main loop on RX_COMMAND
+ * @param none
+ * @return none
+ *****************************************************************************/
+void Command_Process(void) {
+    uint8_t byte;
+
+    while (LDMA_RX_Read(&byte)) {                       // only new bytes, nothing is rescanned
+        Command_Parse_Byte(byte);
+    }
+}
@@ -0,0 +1,114 @@
+/**************************************************************************//**
+ * @file command.h
+ * @brief LEUART command stream parser header
+ * @author Silicon Labs
+ * @version 1.00
+ ******************************************************************************
+ * @section License
+ * <b>(C) Copyright 2014 Silicon Labs, http://www.silabs.com</b>
+ *******************************************************************************
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ * DISCLAIMER OF WARRANTY/LIMITATION OF REMEDIES: Silicon Labs has no
+ * obligation to support this Software. Silicon Labs is providing the
+ * Software "AS IS", with no express or implied warranties of any kind,
+ * including, but not limited to, any implied warranties of merchantability
+ * or fitness for any particular purpose or warranties against infringement
+ * of any proprietary rights of a third party.
+ *
+ * Silicon Labs will not be liable for any consequential, incidental, or
+ * special damages, or any other relief, or for any claim by any third party,
+ * arising from your use of this Software.
+ *
+ ******************************************************************************/
+#ifndef SRC_COMMAND_H_
+#define SRC_COMMAND_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* frame: '?' <letter> [argument] '#', reply: '!' <letter> 'K'|'E' [value] */
+#define COMMAND_MAX_LEN         12      // bytes between '?' and '#'
+#define COMMAND_MAX_DIGITS       9      // longest ARG_UINT, always fits 32 bits
+#define COMMAND_TABLE_SIZE      26      // one entry per letter, upper and lower case share it
+#define COMMAND_REPLY_LEN       13      // '!', letter, status, 10 digits
+
+/* ?sN# statistics */
+#define STAT_TX_DROPS            0      // LDMA_TX_Drops()
+#define STAT_TX_DEPTH            1      // LDMA_TX_Queue_Depth()
+#define STAT_BATCH_OVERRUNS      2      // Batch_Overruns()
+#define STAT_ISR_BASE            8      // + ISR_Id: ISR_Timing_Max()
+#define STAT_SLEEP_RESIDENCY    16      // + EM: Sleep_Residency_ms()
+#define STAT_SLEEP_WAKEUPS      24      // + EM: Sleep_Wakeups()
+
+/******************************************************************************
+ * @brief Parser states, one byte of input moves between them
+ *****************************************************************************/
+typedef enum {
+    PARSE_IDLE,                 // waiting for '?'
+    PARSE_FRAME,                // collecting the frame body until '#'
+    PARSE_OVERFLOW,             // frame longer than COMMAND_MAX_LEN, reject it at '#'
+} Parse_State;
+
+/******************************************************************************
+ * @brief Argument types a command can take
+ *****************************************************************************/
+typedef enum {
+    ARG_NONE,                   // ?s#
+    ARG_CHAR,                   // ?dC#, exactly one character
+    ARG_UINT,                   // ?p3000#, 1 to COMMAND_MAX_DIGITS decimal digits
+    ARG_INT,                    // ?a-500#, ARG_UINT with an optional '-'
+} Command_Arg_Type;
+
+/******************************************************************************
+ * @brief Parsed argument, the member used is given by the table entry
+ *****************************************************************************/
+typedef union {
+    uint8_t  c;
+    uint32_t u;
+    int32_t  i;
+} Command_Arg;
+
+/******************************************************************************
+ * @brief Command implementation, runs in the main loop
+ * @param arg = parsed argument, value = number to append to the reply
+ *        (only used if the entry has returns_value set)
+ * @return false to reply with an error
+ *****************************************************************************/
+typedef bool (*Command_Handler)(const Command_Arg * arg, uint32_t * value);
+
+/******************************************************************************
+ * @brief Command table entry, indexed by the command letter
+ *****************************************************************************/
+typedef struct {
+    Command_Arg_Type arg_type;
+    bool             returns_value;     // append *value to the acknowledgement
+    Command_Handler  handler;           // NULL: unknown command
+} Command_Entry;
+
+/******************************************************************************
+ * @brief Feed one received byte through the parser, a complete frame is
+ *        dispatched and acknowledged right away
+ * @param byte = next byte of the LEUART stream
+ * @return true if this byte completed a frame
+ *****************************************************************************/
+bool Command_Parse_Byte(uint8_t byte);
+
+/******************************************************************************
+ * @brief Consume the bytes received since the last call and apply every
+ *        command found. Runs from the main loop on RX_COMMAND
+ * @param none
+ * @return none
+ *****************************************************************************/
+void Command_Process(void);
+
+#endif /* SRC_COMMAND_H_ */
@@ -0,0 +1,44 @@
+#include "delay.h"
+#include "vtimer.h"
+#include "rtcc.h"
+#include "sleep.h"
+#include <em_core.h>
+
+static volatile bool delay_done;
+
+/******************************************************************************
+ * @brief Virtual timer callback, ends Delay_ms
+ * @param timer: delay_timer
+ * @return delay_done set
+ *****************************************************************************/
+static void Delay_Expired(VTimer * timer) {
+    delay_done = true;
+}
+
+static VTimer delay_timer = { .callback = Delay_Expired };
+
+/******************************************************************************
+ * @brief Wait on a virtual timer, sleeping in the lowest unblocked energy
+ *        mode meanwhile. Interrupts are served, scheduler tasks are not.
+ *        Not for interrupt handlers, and only one delay at a time
+ * @param ms: milliseconds, rounded up to whole RTCC ticks
+ * @return none
+ *****************************************************************************/
+void Delay_ms(uint32_t ms) {
+    CORE_DECLARE_IRQ_STATE;
+
+    if(ms == 0) {
+        return;
+    }
+    delay_done = false;
+    VTimer_Start(&delay_timer, RTCC_US_TO_TICKS((uint64_t)ms * 1000), 0, 0);
+    while(1) {
+        CORE_ENTER_CRITICAL();                      // the timer firing after the check still wakes WFI
+        if(delay_done) {
+            CORE_EXIT_CRITICAL();
+            return;
+        }
+        Enter_Sleep();
+        CORE_EXIT_CRITICAL();                       // RTCC and other handlers run here
+    }
+}
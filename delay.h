@@ -1,6 +1,6 @@
 /**************************************************************************//**
- * @file ldma.h
- * @brief General ldma header
+ * @file delay.h
+ * @brief Sleeping and cycle counted delays header
  * @author Silicon Labs
  * @version 1.00
  ******************************************************************************
@@ -31,17 +31,19 @@
  *
  ******************************************************************************/
 
-#ifndef SRC_CRYO_H_
-#define SRC_CRYO_H_
+#ifndef SRC_DELAY_H_
+#define SRC_DELAY_H_
 
-#include "em_cryotimer.h"
+#include <stdint.h>
+#include "all.h"
 
-#define CRYO_DISABLE        0
-#define CRYO_ENABLE         1
-#define CRYO_DEBUG_DISABLE  0
-#define CRYO_EM4_WAKEUP     0
+/******************************************************************************
+ * @brief Wait on a virtual timer, sleeping in the lowest unblocked energy
+ *        mode meanwhile. Interrupts are served, scheduler tasks are not.
+ *        Not for interrupt handlers, and only one delay at a time
+ * @param ms: milliseconds, rounded up to whole RTCC ticks
+ * @return none
+ *****************************************************************************/
+void Delay_ms(uint32_t ms);
 
-void CRYOTIMER_setup(void);
-void CRYOTIMER_Interrupt_Enable(void);
-
-#endif /* SRC_CRYO_H_ */
+#endif /* SRC_DELAY_H_ */
@@ -0,0 +1,100 @@
+#include "delta.h"
+
+/******************************************************************************
+ * @brief Start a new encoded stream
+ * @param enc = encoder state, buf = destination, size = bytes available
+ * @return none
+ *****************************************************************************/
+void Delta_Encoder_Init(Delta_Encoder * enc, uint8_t * buf, uint8_t size) {
+    enc->buf   = buf;
+    enc->size  = size;
+    enc->len   = 0;
+    enc->count = 0;
+    enc->prev  = 0;
+}
+/******************************************************************************
+ * @brief Append one value, the first one is stored as the base
+ * @param enc = encoder state, value = next sample
+ * @return false if the value does not fit, the stream is unchanged then
+ *****************************************************************************/
+bool Delta_Encode(Delta_Encoder * enc, uint16_t value) {
+    uint8_t  varint[DELTA_VARINT_MAX_LEN];
+    uint8_t  n = 0;
+    int16_t  diff;
+    uint16_t zigzag;
+
+    if (enc->count == 0) {
+        if ((enc->len + DELTA_BASE_LEN) > enc->size) {
+            return false;
+        }
+        enc->buf[enc->len++] = value >> 8;
+        enc->buf[enc->len++] = value & 0xFF;
+    }
+    else {
+        diff   = (int16_t)(uint16_t)(value - enc->prev);                // wraps, so any pair of values round trips
+        zigzag = ((uint16_t)diff << 1) ^ (uint16_t)(diff >> 15);        // small magnitudes of either sign stay small
+        do {
+            varint[n++] = (zigzag & 0x7F) | ((zigzag > 0x7F) ? 0x80 : 0);   // low 7 bits first, MSB = more follow
+            zigzag >>= 7;
+        } while (zigzag);
+        if ((enc->len + n) > enc->size) {
+            return false;
+        }
+        for (uint8_t i = 0; i < n; i++) {
+            enc->buf[enc->len++] = varint[i];
+        }
+    }
+    enc->prev = value;
+    enc->count++;
+    return true;
+}
+/******************************************************************************
+ * @brief Start decoding a stream
+ * @param dec = decoder state, buf = encoded stream, len = its length
+ * @return none
+ *****************************************************************************/
+void Delta_Decoder_Init(Delta_Decoder * dec, const uint8_t * buf, uint8_t len) {
+    dec->buf   = buf;
+    dec->len   = len;
+    dec->pos   = 0;
+    dec->count = 0;
+    dec->prev  = 0;
+}
+/******************************************************************************
+ * @brief Decode the next value
+ * @param dec = decoder state, value = where to store it
+ * @return false at the end of the stream or on a malformed varint
+ *****************************************************************************/
+bool Delta_Decode(Delta_Decoder * dec, uint16_t * value) {
+    uint32_t zigzag = 0;
+    uint8_t  pos = dec->pos;
+    uint8_t  byte;
+
+    if (dec->count == 0) {
+        if ((pos + DELTA_BASE_LEN) > dec->len) {
+            return false;
+        }
+        dec->prev = (dec->buf[pos] << 8) | dec->buf[pos + 1];
+        pos += DELTA_BASE_LEN;
+    }
+    else {
+        for (uint8_t shift = 0; ; shift += 7) {
+            if ((pos == dec->len) || (shift == (7 * DELTA_VARINT_MAX_LEN))) {
+                return false;                                           // truncated or too long
+            }
+            byte = dec->buf[pos++];
+            zigzag |= (uint32_t)(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                break;
+            }
+        }
+        if (zigzag > 0xFFFF) {
+            return false;
+        }
+        dec->prev += (uint16_t)((zigzag >> 1) ^ -(zigzag & 1));         // undo zig-zag, add modulo 2^16
+    }
+    dec->pos = pos;
+    dec->count++;
+    *value = dec->prev;
+    return true;
+}
@@ -0,0 +1,95 @@
+/**************************************************************************//**
+ * @file delta.h
+ * @brief Delta / zig-zag varint sample codec header
+ * @author Silicon Labs
+ * @version 1.00
+ ******************************************************************************
+ * @section License
+ * <b>(C) Copyright 2014 Silicon Labs, http://www.silabs.com</b>
+ *******************************************************************************
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ * DISCLAIMER OF WARRANTY/LIMITATION OF REMEDIES: Silicon Labs has no
+ * obligation to support this Software. Silicon Labs is providing the
+ * Software "AS IS", with no express or implied warranties of any kind,
+ * including, but not limited to, any implied warranties of merchantability
+ * or fitness for any particular purpose or warranties against infringement
+ * of any proprietary rights of a third party.
+ *
+ * Silicon Labs will not be liable for any consequential, incidental, or
+ * special damages, or any other relief, or for any claim by any third party,
+ * arising from your use of this Software.
+ *
+ ******************************************************************************/
+#ifndef SRC_DELTA_H_
+#define SRC_DELTA_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* stream: base value (2 bytes, big endian), then one zig-zag varint per value
+ * holding the difference to the previous value modulo 2^16. Pure C, no
+ * hardware access, so the BLE host can build the same file for decoding */
+#define DELTA_BASE_LEN           2
+#define DELTA_VARINT_MAX_LEN     3      // 16 bit zig-zag value, 7 bits per byte
+
+/******************************************************************************
+ * @brief Streaming encoder state, values are appended one at a time
+ *****************************************************************************/
+typedef struct {
+    uint8_t * buf;
+    uint8_t   size;                     // bytes available in buf
+    uint8_t   len;                      // bytes written so far
+    uint8_t   count;                    // values encoded so far
+    uint16_t  prev;
+} Delta_Encoder;
+
+/******************************************************************************
+ * @brief Streaming decoder state
+ *****************************************************************************/
+typedef struct {
+    const uint8_t * buf;
+    uint8_t   len;                      // bytes in buf
+    uint8_t   pos;                      // next byte to read
+    uint8_t   count;                    // values decoded so far
+    uint16_t  prev;
+} Delta_Decoder;
+
+/******************************************************************************
+ * @brief Start a new encoded stream
+ * @param enc = encoder state, buf = destination, size = bytes available
+ * @return none
+ *****************************************************************************/
+void Delta_Encoder_Init(Delta_Encoder * enc, uint8_t * buf, uint8_t size);
+
+/******************************************************************************
+ * @brief Append one value, the first one is stored as the base
+ * @param enc = encoder state, value = next sample
+ * @return false if the value does not fit, the stream is unchanged then
+ *****************************************************************************/
+bool Delta_Encode(Delta_Encoder * enc, uint16_t value);
+
+/******************************************************************************
+ * @brief Start decoding a stream
+ * @param dec = decoder state, buf = encoded stream, len = its length
+ * @return none
+ *****************************************************************************/
+void Delta_Decoder_Init(Delta_Decoder * dec, const uint8_t * buf, uint8_t len);
+
+/******************************************************************************
+ * @brief Decode the next value
+ * @param dec = decoder state, value = where to store it
+ * @return false at the end of the stream or on a malformed varint
+ *****************************************************************************/
+bool Delta_Decode(Delta_Decoder * dec, uint16_t * value);
+
+#endif /* SRC_DELTA_H_ */
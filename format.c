@@ -0,0 +1,130 @@
+#include "format.h"
+#include "uart.h"
+
+static const uint8_t decimal_divisor[FORMAT_MAX_DECIMALS + 1] = { 100, 10, 1 };
+
+/******************************************************************************
+ * @brief Format a fixed point value as ASCII into a caller supplied buffer.
+ *        Digits are truncated like the original float conversion and a zero
+ *        integer part is sent as spaces (e.g. "+   .4")
+ * @param buf = destination (may be a DMA source buffer), size = bytes
+ *        available in buf, centi = value in hundredths, opts = layout
+ * @return number of bytes written, 0 if the result does not fit in size
+ *****************************************************************************/
+uint8_t Format_Fixed(uint8_t * buf, uint8_t size, int32_t centi, const Format_Options * opts) {
+    uint8_t  digits[10];                                // reversed digits, 2^32 has 10
+    uint8_t  num_digits = 0;
+    uint8_t  int_digits;
+    uint8_t  decimals = opts->decimals;
+    uint8_t  len = 0;
+    uint32_t value;
+    bool     negative;
+
+    if(decimals > FORMAT_MAX_DECIMALS) {
+        decimals = FORMAT_MAX_DECIMALS;
+    }
+    value = (centi < 0) ? (uint32_t)(-centi) : (uint32_t)centi;
+    value /= decimal_divisor[decimals];                 // drop digits beyond the requested precision
+    negative = (centi < 0) && (value != 0);             // don't send "-   .0"
+
+    for(uint8_t i = 0; i < decimals; i++) {             // fractional digits first, least significant first
+        digits[num_digits++] = (value % 10) + ASCII_OFFSET;
+        value /= 10;
+    }
+    while(value) {                                      // integer digits, none for a zero integer part
+        digits[num_digits++] = (value % 10) + ASCII_OFFSET;
+        value /= 10;
+    }
+    if(num_digits == 0) {                               // "0" rather than an empty frame with no decimals
+        digits[num_digits++] = ASCII_OFFSET;
+    }
+    int_digits = num_digits - decimals;
+
+    if((1 + ((int_digits > opts->width) ? int_digits : opts->width) + (decimals ? decimals + 1 : 0) + 1) > size) {
+        return 0;                                       // worst case: sign, integer field, point and decimals, unit
+    }
+
+    if(negative) {
+        buf[len++] = NEGATIVE_SIGN;
+    }
+    else if(opts->sign == FORMAT_SIGN_ALWAYS) {
+        buf[len++] = POSITIVE_SIGN;
+    }
+    for(uint8_t i = int_digits; i < opts->width; i++) { // pad the integer field
+        buf[len++] = SPACE;
+    }
+    while(num_digits > decimals) {                      // integer digits, most significant first
+        buf[len++] = digits[--num_digits];
+    }
+    if(decimals) {
+        buf[len++] = DECIMAL_POINT;
+        while(num_digits) {
+            buf[len++] = digits[--num_digits];
+        }
+    }
+    if(opts->unit) {
+        buf[len++] = opts->unit;
+    }
+    return len;
+}
+/******************************************************************************
+ * @brief Format an unsigned integer as ASCII digits, no sign or padding
+ * @param buf = destination, size = bytes available in buf, value = number
+ * @return number of bytes written, 0 if the result does not fit in size
+ *****************************************************************************/
+uint8_t Format_Uint(uint8_t * buf, uint8_t size, uint32_t value) {
+    uint8_t digits[10];                                 // reversed digits, 2^32 has 10
+    uint8_t num_digits = 0;
+    uint8_t len = 0;
+
+    do {
+        digits[num_digits++] = (value % 10) + ASCII_OFFSET;
+        value /= 10;
+    } while(value);
+
+    if(num_digits > size) {
+        return 0;
+    }
+    while(num_digits) {
+        buf[len++] = digits[--num_digits];
+    }
+    return len;
+}
+/******************************************************************************
+ * @brief CRC-8 (FRAME_CRC_POLY, initial value 0, no reflection)
+ * @param data = bytes to check, length = number of bytes
+ * @return CRC of data
+ *****************************************************************************/
+uint8_t Format_CRC8(const uint8_t * data, uint8_t length) {
+    uint8_t crc = 0;
+
+    for(uint8_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for(uint8_t bit = 0; bit < 8; bit++) {          // bitwise, a frame is only 5 bytes
+            crc = (crc & 0x80) ? ((crc << 1) ^ FRAME_CRC_POLY) : (crc << 1);
+        }
+    }
+    return crc;
+}
+/******************************************************************************
+ * @brief Build a binary telemetry frame into a caller supplied buffer
+ * @param buf = destination (may be a DMA source buffer), size = bytes
+ *        available in buf, type = FRAME_TYPE_*, seq = sequence number,
+ *        value = 16 bit payload, crc = append a CRC-8
+ * @return number of bytes written, 0 if the frame does not fit in size
+ *****************************************************************************/
+uint8_t Format_Binary(uint8_t * buf, uint8_t size, uint8_t type, uint8_t seq, uint16_t value, bool crc) {
+    if((FRAME_LEN + (crc ? 1 : 0)) > size) {
+        return 0;
+    }
+    buf[0] = FRAME_SYNC;
+    buf[1] = crc ? (type | FRAME_TYPE_CRC) : type;      // receiver knows the length from the type
+    buf[2] = seq;
+    buf[3] = value >> 8;                                // big endian, like the Si7021
+    buf[4] = value & 0xFF;
+    if(crc) {
+        buf[FRAME_LEN] = Format_CRC8(buf, FRAME_LEN);
+        return FRAME_LEN + 1;
+    }
+    return FRAME_LEN;
+}
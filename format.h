@@ -0,0 +1,132 @@
+/**************************************************************************//**
+ * @file format.h
+ * @brief Shared fixed point to ASCII telemetry formatter header
+ * @author Silicon Labs
+ * @version 1.00
+ ******************************************************************************
+ * @section License
+ * <b>(C) Copyright 2014 Silicon Labs, http://www.silabs.com</b>
+ *******************************************************************************
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ * DISCLAIMER OF WARRANTY/LIMITATION OF REMEDIES: Silicon Labs has no
+ * obligation to support this Software. Silicon Labs is providing the
+ * Software "AS IS", with no express or implied warranties of any kind,
+ * including, but not limited to, any implied warranties of merchantability
+ * or fitness for any particular purpose or warranties against infringement
+ * of any proprietary rights of a third party.
+ *
+ * Silicon Labs will not be liable for any consequential, incidental, or
+ * special damages, or any other relief, or for any claim by any third party,
+ * arising from your use of this Software.
+ *
+ ******************************************************************************/
+
+#ifndef SRC_FORMAT_H_
+#define SRC_FORMAT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "all.h"
+
+#define FORMAT_MAX_LEN          16      // longest frame Format_Fixed() can produce
+#define FORMAT_MAX_DECIMALS      2      // values are in hundredths
+
+/* binary frame: sync, type, sequence, value (big endian) [, CRC-8 over all previous bytes] */
+#define FRAME_SYNC            0xA5      // first byte of every binary frame
+#define FRAME_TYPE_CENTI_C    0x01      // value: int16, hundredths of a degree celsius
+#define FRAME_TYPE_CENTI_F    0x02      // value: int16, hundredths of a degree fahrenheit
+#define FRAME_TYPE_RAW        0x03      // value: uint16, Si7021 temperature code
+#define FRAME_TYPE_DELTA      0x04      // sequence, count, then delta.h stream of raw codes
+#define FRAME_TYPE_CRC        0x80      // or'ed into the type when a CRC byte follows
+#define FRAME_LEN                5      // without CRC
+#define FRAME_CRC_POLY        0x07      // CRC-8, x^8 + x^2 + x + 1, initial value 0
+
+/******************************************************************************
+ * @brief Telemetry encoding
+ *****************************************************************************/
+typedef enum {
+    FORMAT_ASCII,                       // legacy "+ 23.4C"
+    FORMAT_BINARY_FIXED,                // FRAME_TYPE_CENTI_C / FRAME_TYPE_CENTI_F
+    FORMAT_BINARY_RAW,                  // FRAME_TYPE_RAW
+    FORMAT_BINARY_DELTA,                // FRAME_TYPE_DELTA, one frame per batch
+    FORMAT_KIND_COUNT
+} Format_Kind;
+
+#ifdef TELEMETRY_BINARY
+#define FORMAT_KIND_DEFAULT     FORMAT_BINARY_FIXED
+#else
+#define FORMAT_KIND_DEFAULT     FORMAT_ASCII
+#endif
+#ifdef TELEMETRY_CRC
+#define FORMAT_CRC_DEFAULT      true
+#else
+#define FORMAT_CRC_DEFAULT      false
+#endif
+
+/******************************************************************************
+ * @brief Sign character policy
+ *****************************************************************************/
+typedef enum {
+    FORMAT_SIGN_ALWAYS,                 // '+' or '-'
+    FORMAT_SIGN_NEGATIVE,               // '-' only, nothing for positive values
+} Format_Sign;
+
+/******************************************************************************
+ * @brief Output layout: [sign][spaces][integer digits][.][decimals][unit]
+ *****************************************************************************/
+typedef struct {
+    uint8_t     width;                  // integer field width, padded with leading spaces
+    uint8_t     decimals;               // digits after the decimal point (0 - FORMAT_MAX_DECIMALS)
+    Format_Sign sign;
+    char        unit;                   // suffix character, 0 for none
+    Format_Kind kind;                   // ASCII layout above or a binary frame
+    bool        crc;                    // binary frames only
+} Format_Options;
+
+/* legacy 7 byte frame: "+ 23.4C" (unless TELEMETRY_BINARY) */
+#define FORMAT_OPTIONS_DEFAULT  { 3, 1, FORMAT_SIGN_ALWAYS, 0, FORMAT_KIND_DEFAULT, FORMAT_CRC_DEFAULT }
+
+/******************************************************************************
+ * @brief Format a fixed point value as ASCII into a caller supplied buffer.
+ *        Digits are truncated like the original float conversion and a zero
+ *        integer part is sent as spaces (e.g. "+   .4")
+ * @param buf = destination (may be a DMA source buffer), size = bytes
+ *        available in buf, centi = value in hundredths, opts = layout
+ * @return number of bytes written, 0 if the result does not fit in size
+ *****************************************************************************/
+uint8_t Format_Fixed(uint8_t * buf, uint8_t size, int32_t centi, const Format_Options * opts);
+
+/******************************************************************************
+ * @brief Format an unsigned integer as ASCII digits, no sign or padding
+ * @param buf = destination, size = bytes available in buf, value = number
+ * @return number of bytes written, 0 if the result does not fit in size
+ *****************************************************************************/
+uint8_t Format_Uint(uint8_t * buf, uint8_t size, uint32_t value);
+
+/******************************************************************************
+ * @brief CRC-8 (FRAME_CRC_POLY, initial value 0, no reflection)
+ * @param data = bytes to check, length = number of bytes
+ * @return CRC of data
+ *****************************************************************************/
+uint8_t Format_CRC8(const uint8_t * data, uint8_t length);
+
+/******************************************************************************
+ * @brief Build a binary telemetry frame into a caller supplied buffer
+ * @param buf = destination (may be a DMA source buffer), size = bytes
+ *        available in buf, type = FRAME_TYPE_*, seq = sequence number,
+ *        value = 16 bit payload, crc = append a CRC-8
+ * @return number of bytes written, 0 if the frame does not fit in size
+ *****************************************************************************/
+uint8_t Format_Binary(uint8_t * buf, uint8_t size, uint8_t type, uint8_t seq, uint16_t value, bool crc);
+
+#endif /* SRC_FORMAT_H_ */
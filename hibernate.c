@@ -0,0 +1,168 @@
+#include "hibernate.h"
+#include "em_emu.h"
+#include "em_rmu.h"
+#include "em_rtcc.h"
+#include "em_gpio.h"
+#include "timer.h"
+#include "ldma.h"
+#include "i2c.h"
+#include "main.h"
+
+#define HIBERNATE_IMAGE_WORDS  ((sizeof(Hibernate_Image) + 3) / 4)
+
+_Static_assert(HIBERNATE_IMAGE_WORDS <= (sizeof(RTCC->RET) / sizeof(RTCC->RET[0])), "image must fit the RTCC retention registers");
+
+/******************************************************************************
+ * @brief Word view of the image, the retention registers are 32 bit only
+ *****************************************************************************/
+typedef union {
+    Hibernate_Image image;
+    uint32_t        words[HIBERNATE_IMAGE_WORDS];
+} Hibernate_Words;
+
+extern volatile bool isCelsius;
+extern Format_Options tx_format;
+extern Report_Mode report_mode;
+
+static bool     resumed;                            // woken from EM4H, last_wakeup is valid
+static uint32_t last_wakeup;                        // RTCC timestamp the last EM4H wakeup was programmed for
+static bool     button_wakeup;                      // HIBERNATE_BUTTON_PIN ended the last EM4H
+
+/******************************************************************************
+ * @brief RTCC timestamp of the next sample's COMP0. The LETIMER restarts
+ *        after every wakeup, so its COMP0 follows the programmed wakeup by
+ *        the boot time. That delay, seen in the current period, is taken off
+ *        so the cadence stays one period per sample across resets
+ * @param none
+ * @return wakeup timestamp for the RTCC compare
+ *****************************************************************************/
+static uint32_t Hibernate_Wakeup(void) {
+    uint32_t start = letimer_get_period_start();
+    uint32_t wakeup = start + RTCC_MS_TO_TICKS(letimer_get_period());
+    uint32_t boot = start - last_wakeup;
+
+    if (resumed && (boot < RTCC_MS_TO_TICKS(HIBERNATE_MAX_BOOT_MS))) {
+        wakeup -= boot;                             // this period started with the first COMP0 after the wakeup
+    }
+    return wakeup;
+}
+
+/******************************************************************************
+ * @brief Check the reset cause and, after an EM4 wakeup, restore the state
+ *        saved by Hibernate_Enter. Call right after cmu_init
+ * @param none
+ * @return true for a warm boot out of EM4H with valid retained state
+ *****************************************************************************/
+bool Hibernate_Resume(void) {
+    Hibernate_Words retained;
+    uint32_t cause = RMU_ResetCauseGet();
+
+    RMU_ResetCauseClear();
+    RTCC_EM4WakeupEnable(false);                    // the compare is only armed by Hibernate_Enter
+    RTCC_IntDisable(RTCC_IEN_CC2);                  // HIBERNATE_RTCC_CH
+    RTCC_IntClear(RTCC_IFC_CC2);
+    button_wakeup = (cause & RMU_RSTCAUSE_EM4RST) && (GPIO_EM4GetPinWakeupCause() & HIBERNATE_BUTTON_EM4WU);
+    GPIO_EM4DisablePinWakeup(HIBERNATE_BUTTON_EM4WU);
+    GPIO->IFC = HIBERNATE_BUTTON_EM4WU;             // EM4WU flags share the bit positions of EXTILEVEL
+    if (!(cause & RMU_RSTCAUSE_EM4RST)) {
+        return false;                               // power-on, pin or watchdog reset: cold boot
+    }
+    for (uint32_t i = 0; i < HIBERNATE_IMAGE_WORDS; i++) {
+        retained.words[i] = RTCC->RET[i].REG;
+    }
+    if (retained.image.magic != HIBERNATE_MAGIC) {
+        return false;
+    }
+    RTCC->RET[0].REG = 0;                           // consumed, a later reset must not see it again
+
+    resumed = true;
+    last_wakeup = retained.image.wakeup;
+    letimer_set_period(retained.image.period_ms, letimer_get_powerup());    // loaded by the first COMP0
+    isCelsius = retained.image.celsius;
+    if (retained.image.report_mode < REPORT_MODE_COUNT) {
+        report_mode = (Report_Mode)retained.image.report_mode;
+    }
+    if (retained.image.format.kind < FORMAT_KIND_COUNT) {
+        tx_format.width    = retained.image.format.width;
+        tx_format.decimals = retained.image.format.decimals;
+        tx_format.sign     = (Format_Sign)retained.image.format.sign;
+        tx_format.unit     = retained.image.format.unit;
+        tx_format.kind     = (Format_Kind)retained.image.format.kind;
+        tx_format.crc      = retained.image.format.crc;
+    }
+    Report_Restore(&retained.image.report);
+    Adapt_Restore(&retained.image.adapt);
+    Batch_Restore(&retained.image.batch);                                   // after the period, Batch_Due uses it
+    return true;
+}
+/******************************************************************************
+ * @brief Check whether the last EM4H wakeup was the button instead of the
+ *        RTCC
+ * @param none
+ * @return true if HIBERNATE_BUTTON_PIN ended hibernation
+ *****************************************************************************/
+bool Hibernate_Button_Wakeup(void) {
+    return button_wakeup;
+}
+/******************************************************************************
+ * @brief Check whether the device may hibernate now instead of sleeping
+ * @param none
+ * @return true if HIBERNATE_EM4 is enabled, the sample period is long enough,
+ *         the next sample is not imminent and no transfer is in progress
+ *****************************************************************************/
+bool Hibernate_Allowed(void) {
+#ifdef HIBERNATE_EM4
+    return (letimer_get_period() >= HIBERNATE_MIN_PERIOD_MS)
+            && ((int32_t)(Hibernate_Wakeup() - RTCC_Now()) > (int32_t)RTCC_MS_TO_TICKS(HIBERNATE_MIN_SLEEP_MS))
+            && !LDMA_TX_Busy()                      // last frame must have left the LEUART
+            && !I2C_Transaction_Busy();
+#else
+    return false;
+#endif
+}
+/******************************************************************************
+ * @brief Save the retained state and enter EM4H until the RTCC wakes the
+ *        device for the next sample, one LETIMER period after the last
+ *        COMP0, or HIBERNATE_BUTTON_PIN is pressed. Does not return, the
+ *        wakeup is a reset into main
+ * @param none
+ * @return none
+ *****************************************************************************/
+void Hibernate_Enter(void) {
+    EMU_EM4Init_TypeDef em4Init = EMU_EM4INIT_DEFAULT;
+    RTCC_CCChConf_TypeDef compare = RTCC_CH_INIT_COMPARE_DEFAULT;
+    Hibernate_Words retained;
+
+    retained.image.magic           = HIBERNATE_MAGIC;
+    retained.image.period_ms       = letimer_get_next_period();   // a pending change starts with the next sample
+    retained.image.wakeup          = Hibernate_Wakeup();
+    retained.image.celsius         = isCelsius;
+    retained.image.report_mode     = report_mode;
+    retained.image.format.width    = tx_format.width;
+    retained.image.format.decimals = tx_format.decimals;
+    retained.image.format.sign     = tx_format.sign;
+    retained.image.format.unit     = tx_format.unit;
+    retained.image.format.kind     = tx_format.kind;
+    retained.image.format.crc      = tx_format.crc;
+    Report_Save(&retained.image.report);
+    Adapt_Save(&retained.image.adapt);
+    Batch_Save(&retained.image.batch);
+    for (uint32_t i = 0; i < HIBERNATE_IMAGE_WORDS; i++) {
+        RTCC->RET[i].REG = retained.words[i];
+    }
+
+    em4Init.em4State         = emuEM4Hibernate;     // RTCC retention registers survive
+    em4Init.retainLfxo       = true;                // keeps the RTCC counting
+    em4Init.pinRetentionMode = emuPinRetentionDisable;    // sensor enable floats low, the Si7021 is off
+    EMU_EM4Init(&em4Init);
+
+    RTCC_ChannelInit(HIBERNATE_RTCC_CH, &compare);
+    RTCC_ChannelCCVSet(HIBERNATE_RTCC_CH, retained.image.wakeup);
+    RTCC_IntClear(RTCC_IFC_CC2);                    // HIBERNATE_RTCC_CH
+    RTCC_IntEnable(RTCC_IEN_CC2);
+    RTCC_EM4WakeupEnable(true);
+    GPIO_PinModeSet(HIBERNATE_BUTTON_PORT, HIBERNATE_BUTTON_PIN, gpioModeInputPullFilter, 1);
+    GPIO_EM4EnablePinWakeup(HIBERNATE_BUTTON_EM4WU, 0);                    // wake on low, the button pulls to ground
+    EMU_EnterEM4();
+    while (1);                                      // not reached, EM4 exit is a reset
+}
@@ -0,0 +1,116 @@
+/**************************************************************************//**
+ * @file hibernate.h
+ * @brief EM4 hibernation between samples header
+ * @author Silicon Labs
+ * @version 1.00
+ ******************************************************************************
+ * @section License
+ * <b>(C) Copyright 2014 Silicon Labs, http://www.silabs.com</b>
+ *******************************************************************************
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ * DISCLAIMER OF WARRANTY/LIMITATION OF REMEDIES: Silicon Labs has no
+ * obligation to support this Software. Silicon Labs is providing the
+ * Software "AS IS", with no express or implied warranties of any kind,
+ * including, but not limited to, any implied warranties of merchantability
+ * or fitness for any particular purpose or warranties against infringement
+ * of any proprietary rights of a third party.
+ *
+ * Silicon Labs will not be liable for any consequential, incidental, or
+ * special damages, or any other relief, or for any claim by any third party,
+ * arising from your use of this Software.
+ *
+ ******************************************************************************/
+
+#ifndef SRC_HIBERNATE_H_
+#define SRC_HIBERNATE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "batch.h"
+#include "report.h"
+#include "adapt.h"
+#include "all.h"
+
+#define HIBERNATE_MAGIC          0x4842524EUL   // "HBRN", image in the RTCC retention registers is valid
+#define HIBERNATE_MIN_PERIOD_MS  60000          // shorter periods stay in EM2, a cold peripheral start costs more
+#define HIBERNATE_MIN_SLEEP_MS    1000          // less time left to the next sample is spent in EM2
+#define HIBERNATE_MAX_BOOT_MS      100          // longer wakeup to COMP0 delays are not compensated
+#define HIBERNATE_RTCC_CH            2          // RTCC compare channel that ends EM4H, 1 belongs to vtimer
+
+/* touch is not serviced in EM4H, a press of the kit's BTN1 wakes the device and stops sampling instead */
+#define HIBERNATE_BUTTON_PORT    gpioPortF
+#define HIBERNATE_BUTTON_PIN             7
+#define HIBERNATE_BUTTON_EM4WU   GPIO_EXTILEVEL_EM4WU1  // PF7, active low
+
+/******************************************************************************
+ * @brief Format_Options in bytes, the enums would take a word each
+ *****************************************************************************/
+typedef struct {
+    uint8_t width;
+    uint8_t decimals;
+    uint8_t sign;
+    char    unit;
+    uint8_t kind;
+    bool    crc;
+} Hibernate_Format;
+
+/******************************************************************************
+ * @brief State kept in the RTCC retention registers while in EM4H, RAM is lost
+ *****************************************************************************/
+typedef struct {
+    uint32_t         magic;
+    uint32_t         period_ms;     // sample period
+    uint32_t         wakeup;        // RTCC timestamp the wakeup was programmed for
+    bool             celsius;       // unit selection
+    uint8_t          report_mode;   // 'm' command
+    Hibernate_Format format;        // telemetry encoding
+    Report_Retained  report;        // deadband, alert and heartbeat state
+    Adapt_Retained   adapt;         // adaptive period controller
+    Batch_Retained   batch;         // unsent samples, sequence counter and flush settings
+} Hibernate_Image;
+
+/******************************************************************************
+ * @brief Check the reset cause and, after an EM4 wakeup, restore the state
+ *        saved by Hibernate_Enter. Call right after cmu_init
+ * @param none
+ * @return true for a warm boot out of EM4H with valid retained state
+ *****************************************************************************/
+bool Hibernate_Resume(void);
+
+/******************************************************************************
+ * @brief Check whether the last EM4H wakeup was the button instead of the
+ *        RTCC
+ * @param none
+ * @return true if HIBERNATE_BUTTON_PIN ended hibernation
+ *****************************************************************************/
+bool Hibernate_Button_Wakeup(void);
+
+/******************************************************************************
+ * @brief Check whether the device may hibernate now instead of sleeping
+ * @param none
+ * @return true if HIBERNATE_EM4 is enabled, the sample period is long enough,
+ *         the next sample is not imminent and no transfer is in progress
+ *****************************************************************************/
+bool Hibernate_Allowed(void);
+
+/******************************************************************************
+ * @brief Save the retained state and enter EM4H until the RTCC wakes the
+ *        device for the next sample, one LETIMER period after the last
+ *        COMP0, or HIBERNATE_BUTTON_PIN is pressed. Does not return, the
+ *        wakeup is a reset into main
+ * @param none
+ * @return none
+ *****************************************************************************/
+void Hibernate_Enter(void);
+
+#endif /* SRC_HIBERNATE_H_ */
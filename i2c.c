@@ -1,13 +1,18 @@
 #include "i2c.h"
 #include "gpio.h"
+#include <em_core.h>
+#include "isrtime.h"
+#include "vtimer.h"
+#include "rtcc.h"
 
-extern volatile bool ACK_done;
-volatile bool bit_flag = true;
+static I2C_Transaction * volatile active_trans;                 // descriptor being run by I2C0_IRQHandler
+static volatile I2C_State i2c_state = I2C_STATE_IDLE;
+static volatile I2C_Status i2c_status;
+static volatile uint8_t tx_idx;                                 // next byte of active_trans->tx_data to write
+static volatile uint8_t rx_idx;                                 // next byte of active_trans->rx_data to fill
 
-#ifdef READ_TEMPERATURE
-volatile uint16_t temp_ms_read;
-volatile uint16_t temp_ls_read;
-#endif
+static void I2C_Timeout(VTimer * timer);
+static VTimer i2c_timeout = { .callback = I2C_Timeout };        // bounds every transaction, also I2C_Transaction_Wait
 
 /******************************************************************************
  * @brief - Configure I2C peripheral with asymmetric clock duty cycle and max SCL
@@ -36,6 +41,9 @@ void I2C_Setup(void) {
     GPIO_PinModeSet(SCL_PORT, SCL_PIN, gpioModeDisabled, OFF);  // set up GPIO pin PC11 (SCL) to disabled when not in use
     GPIO_PinModeSet(SDA_PORT, SDA_PIN, gpioModeDisabled, OFF);  // set up GPIO pin PC10 (SDA) to disabled when not in use
 
+    NVIC_ClearPendingIRQ(I2C0_IRQn);
+    NVIC_EnableIRQ(I2C0_IRQn);                                  // IEN stays 0 until a transaction is submitted
+
     I2C_Enable(I2C0, true);                                     // enable I2C
 }
 
@@ -100,48 +108,108 @@ void I2C_Write_to_Reg_NoInterrupts(uint8_t slave_addr_rw, uint8_t cmd, uint8_t d
 
 
 /******************************************************************************
- * @brief Write value to a register on the Si7021 temp sensor with interrupts
+ * @brief Write value to a register on the Si7021 temp sensor with interrupts,
+ *        sleeping in EM1 until the STOP has been sent
  * @param slave_addr_rw: address of slave to read or write from, cmd: command to
  *        send to slave, data: data to write to temp sensor register
  * @return none
  *****************************************************************************/
 void I2C_Write_Interrupts(uint8_t slave_addr, uint8_t cmd, uint8_t data){
-    ACK_done     = 0;
-    I2C0->CMD    = I2C_CMD_START;                               // send START condition to slave
-    I2C0->TXDATA = (slave_addr << 1) | I2C_WRITE;               // send slave addr in upper 7 bits
-                                                                // WRITE bit in LSB to send command before reading
-    while(!ACK_done);
-    ACK_done     = 0;
-    I2C0->TXDATA = cmd;                                         // send command to temp sensor
-    while(!ACK_done);
-    ACK_done     = 0;
-    I2C0->TXDATA = data;                                        // send data to temp sensor
-    I2C0->CMD    = I2C_CMD_ACK;                                 // send ACK to slave
-    I2C0->CMD    = I2C_CMD_STOP;                                // send STOP to slave
+    uint8_t tx_data[2] = { cmd, data };
+    I2C_Transaction trans = { slave_addr, tx_data, 2, NULL, 0, NULL };
+
+    while(!I2C_Transaction_Submit(&trans)) {                    // wait for any transaction already in flight
+        I2C_Transaction_Wait();
+    }
+    I2C_Transaction_Wait();                                     // trans lives on this stack, so wait for it
 }
 
 
 /******************************************************************************
- * @brief Read temperature from Si7021 temp sensor with interrupts
+ * @brief Read value of a register on the Si7021 temp sensor with interrupts,
+ *        sleeping in EM1 until the STOP has been sent
  * @param slave_addr_rw: address of slave to read or write from, cmd: command to
  *        send to slave
- * @return temp_ls_read: least significant byte of temperature from temp sensor (set in I2C interrupt handler)
- *         temp_ms_read: most significant byte of temperature from temp sensor (set in I2C interrupt handler)
+ * @return data: data read from temp sensor register
  *****************************************************************************/
-void I2C_Read_Interrupts(uint8_t slave_addr, uint8_t cmd){
-    ACK_done     = 0;
-    I2C0->CMD    = I2C_CMD_START;                               // send START condition to slave
-    I2C0->TXDATA = (slave_addr << 1) | I2C_WRITE;               // send slave addr in upper 7 bits
-                                                                // WRITE bit in LSB to send command before reading
-    while(!ACK_done);
-    ACK_done     = 0;
-    I2C0->TXDATA = cmd;                                         // send command to temp sensor
-    while(!ACK_done);
-    ACK_done     = 0;
-    I2C0->CMD    = I2C_CMD_START;                               // send REPEATED START to slave
-    I2C0->TXDATA = (slave_addr << 1) | I2C_READ;                // send slave addr and READ bit
-    while(!ACK_done);
-    ACK_done = 0;
+uint8_t I2C_Read_Interrupts(uint8_t slave_addr, uint8_t cmd){
+    uint8_t data = 0;
+    I2C_Transaction trans = { slave_addr, &cmd, 1, &data, 1, NULL };
+
+    while(!I2C_Transaction_Submit(&trans)) {                    // wait for any transaction already in flight
+        I2C_Transaction_Wait();
+    }
+    I2C_Transaction_Wait();                                     // trans lives on this stack, so wait for it
+    return data;
+}
+
+
+/******************************************************************************
+ * @brief Start an interrupt driven transaction and return immediately
+ * @param trans: descriptor to run, owned by the caller until its callback
+ * @return false if another transaction is still in flight
+ *****************************************************************************/
+bool I2C_Transaction_Submit(I2C_Transaction * trans) {
+    CORE_DECLARE_IRQ_STATE;
+
+    CORE_ENTER_CRITICAL();
+    if(i2c_state != I2C_STATE_IDLE) {                           // engine can only run one transaction at a time
+        CORE_EXIT_CRITICAL();
+        return false;
+    }
+    i2c_state = ((trans->tx_len > 0) || (trans->rx_len == 0)) ? I2C_STATE_ADDR_W : I2C_STATE_ADDR_R;   // 0/0: address probe, STOP on ACK
+    CORE_EXIT_CRITICAL();
+
+    active_trans = trans;
+    tx_idx       = 0;
+    rx_idx       = 0;
+    i2c_status   = I2C_STATUS_DONE;
+    Sleep_Restore_Clocks();                                     // baud divider assumes the configured HFPERCLK
+    Sleep_Block_Mode(I2C_ASYNC_EM_BLOCK);                       // HFPERCLK must keep running until MSTOP
+
+    I2C0->CMD = I2C_CMD_CLEARPC | I2C_CMD_CLEARTX;              // drop anything left over from a previous transfer
+    I2C0->IFC = _I2C_IFC_MASK;                                  // clear stale flags
+    I2C_Interrupt_Enable();
+    VTimer_Start(&i2c_timeout, RTCC_MS_TO_TICKS(I2C_TIMEOUT_MS), 0, 0);
+
+    I2C0->CMD = I2C_CMD_START;                                  // send START condition to slave
+    if(i2c_state == I2C_STATE_ADDR_W) {
+        I2C0->TXDATA = (trans->slave_addr << 1) | I2C_WRITE;    // write phase first
+    }
+    else {
+        I2C0->TXDATA = (trans->slave_addr << 1) | I2C_READ;     // read only transaction
+    }
+    return true;
+}
+
+
+/******************************************************************************
+ * @brief Check if a transaction is in flight
+ * @param none
+ * @return true until the STOP of the current transaction has been sent
+ *****************************************************************************/
+bool I2C_Transaction_Busy(void) {
+    return i2c_state != I2C_STATE_IDLE;
+}
+
+
+/******************************************************************************
+ * @brief Sleep in EM1 until the current transaction completes or is aborted,
+ *        at most I2C_TIMEOUT_MS. Must not be called from an ISR that can't be
+ *        preempted by I2C0_IRQHandler and RTCC_IRQHandler
+ * @param none
+ * @return none
+ *****************************************************************************/
+void I2C_Transaction_Wait(void) {
+    CORE_DECLARE_IRQ_STATE;
+
+    CORE_ENTER_CRITICAL();                                      // close the window between the busy check and WFI
+    while(I2C_Transaction_Busy()) {
+        Enter_Sleep();                                          // WFI still wakes on a pending IRQ while masked
+        CORE_EXIT_CRITICAL();                                   // let I2C0_IRQHandler advance the state machine
+        CORE_ENTER_CRITICAL();
+    }
+    CORE_EXIT_CRITICAL();
 }
 
 
@@ -167,7 +235,11 @@ void I2C_Reset_Bus(void) {
 void I2C_Interrupt_Enable(void) {
     I2C0->IEN = 0;                                              // Clear IEN
     I2C0->IEN |= I2C_IEN_RXDATAV |
-                 I2C_IEN_ACK;
+                 I2C_IEN_ACK     |
+                 I2C_IEN_NACK    |
+                 I2C_IEN_MSTOP   |
+                 I2C_IEN_BUSERR  |
+                 I2C_IEN_ARBLOST;
     NVIC_EnableIRQ(I2C0_IRQn);
 }
 
@@ -179,53 +251,129 @@ void I2C_Interrupt_Enable(void) {
  *****************************************************************************/
 void I2C_Interrupt_Disable(void) {
     I2C0->IEN &= ~(I2C_IEN_RXDATAV |                            // Disable whats enabled above
-                   I2C_IEN_ACK);
+                   I2C_IEN_ACK     |
+                   I2C_IEN_NACK    |
+                   I2C_IEN_MSTOP   |
+                   I2C_IEN_BUSERR  |
+                   I2C_IEN_ARBLOST);
     NVIC_DisableIRQ(I2C0_IRQn);
 }
 
 
 /******************************************************************************
- * @brief I2C interrupt handler to read from a register or the temperature value
- *        on the Si7021 temp sensor
- * @param ACK_done: set when ACK has been successfully received and is used in
- *        I2C_Read_Interrupts() and I2C_Write_Interrupts()
- * @return temp_ls_read: least significant byte of temperature from temp sensor
- *         temp_ms_read: most significant byte of temperature from temp sensor
+ * @brief End the active transaction: stop its timeout, release the EM block
+ *        and report the result. Runs in I2C0_IRQHandler or RTCC_IRQHandler
+ * @param status: result handed to the callback
+ * @return none
  *****************************************************************************/
-void I2C0_IRQHandler(void)
- {
-#ifdef RW_FROM_REGISTER                                         // Set in all.h
-    int status;
-    status = I2C0->IF;
-
-    if (status & I2C_IF_ACK) {
-        I2C0->IFC |= I2C_IFC_ACK;                               // clear ACK flag
-        ACK_done = 1;
+static void I2C_Transaction_End(I2C_Status status) {
+    I2C_Transaction * trans = active_trans;
+
+    I2C0->IEN = 0;                                              // keep the polled *_NoInterrupts helpers usable
+    VTimer_Stop(&i2c_timeout);
+    i2c_state = I2C_STATE_IDLE;                                 // idle before callback so it may submit again
+    Sleep_UnBlock_Mode(I2C_ASYNC_EM_BLOCK);
+    if (trans->callback) {
+        trans->callback(trans, status);
     }
-    if (status & I2C_IF_RXDATAV){
-        read_data = I2C0->RXDOUBLE;                             // read data from RX buffer (automatically clears RXDATAV flag)
-        I2C0->CMD = I2C_CMD_NACK;                               // send NACK to slave
-        I2C0->CMD = I2C_CMD_STOP;                               // send STOP to slave
+}
+
+
+/******************************************************************************
+ * @brief Abort the active transaction after a bus error, lost arbitration or
+ *        timeout. An abort sends no STOP, so MSTOP never comes to end it
+ * @param status: I2C_STATUS_BUS_ERROR or I2C_STATUS_TIMEOUT
+ * @return none
+ *****************************************************************************/
+static void I2C_Transaction_Abort(I2C_Status status) {
+    I2C0->CMD = I2C_CMD_ABORT | I2C_CMD_CLEARPC | I2C_CMD_CLEARTX;  // release the bus at once
+    I2C0->IFC = _I2C_IFC_MASK;
+    I2C_Transaction_End(status);
+}
+
+
+/******************************************************************************
+ * @brief Transaction took longer than I2C_TIMEOUT_MS, runs from the RTCC
+ *        interrupt with interrupts disabled
+ * @param timer: i2c_timeout
+ * @return none
+ *****************************************************************************/
+static void I2C_Timeout(VTimer * timer) {
+    if (i2c_state != I2C_STATE_IDLE) {
+        I2C_Transaction_Abort(I2C_STATUS_TIMEOUT);
     }
-#endif
-#ifdef READ_TEMPERATURE
-    int status;
-    status = I2C0->IF;
+}
 
+
+/******************************************************************************
+ * @brief I2C interrupt handler: advances the transaction state machine
+ *        START/ADDR -> ACK -> TX data -> (repeated START/ADDR -> ACK) ->
+ *        RXDATAV (ACK each byte, NACK the last) -> STOP -> MSTOP
+ * @param active_trans: descriptor submitted through I2C_Transaction_Submit()
+ * @return active_trans->rx_data: filled with rx_len bytes, callback invoked
+ *         with the result once MSTOP is seen
+ *****************************************************************************/
+void I2C0_IRQHandler(void) {
+    ISR_TIMING_START();
+    uint32_t status;
+    I2C_Transaction * trans = active_trans;
+    status = I2C0->IF & I2C0->IEN;
+
+    if (status & (I2C_IF_BUSERR | I2C_IF_ARBLOST)) {            // no MSTOP will follow, end it here
+        I2C_Transaction_Abort(I2C_STATUS_BUS_ERROR);
+        status = 0;                                             // the other flags belong to the aborted transfer
+    }
+    if (status & I2C_IF_NACK) {                                 // slave refused address or data
+        I2C0->IFC = I2C_IFC_NACK;
+        i2c_status = I2C_STATUS_NACK;
+        i2c_state  = I2C_STATE_STOP;
+        I2C0->CMD  = I2C_CMD_STOP;                              // release the bus, completion reported on MSTOP
+    }
     if (status & I2C_IF_ACK) {
-        I2C0->IFC |= I2C_IFC_ACK;                               // clear ACK flag
-        ACK_done = 1;    
+        I2C0->IFC = I2C_IFC_ACK;                                // clear ACK flag
+        switch (i2c_state) {
+            case I2C_STATE_ADDR_W:
+            case I2C_STATE_TX_DATA:
+                if (tx_idx < trans->tx_len) {                   // more bytes to write
+                    i2c_state    = I2C_STATE_TX_DATA;
+                    I2C0->TXDATA = trans->tx_data[tx_idx++];
+                }
+                else if (trans->rx_len > 0) {                   // write phase done, turn the bus around
+                    i2c_state    = I2C_STATE_ADDR_R;
+                    I2C0->CMD    = I2C_CMD_START;               // send REPEATED START to slave
+                    I2C0->TXDATA = (trans->slave_addr << 1) | I2C_READ;
+                }
+                else {                                          // write only transaction
+                    i2c_state = I2C_STATE_STOP;
+                    I2C0->CMD = I2C_CMD_STOP;
+                }
+                break;
+            case I2C_STATE_ADDR_R:
+                i2c_state = I2C_STATE_RX_DATA;                  // slave now clocks out data (may stretch SCL)
+                break;
+            default:
+                break;
+        }
     }
-    if ((status & I2C_IF_RXDATAV) && bit_flag) {
-        temp_ms_read = I2C0->RXDOUBLE;
-        I2C0->CMD = I2C_CMD_ACK;
-        bit_flag = false;
+    if (status & I2C_IF_RXDATAV) {
+        if (i2c_state == I2C_STATE_RX_DATA) {
+            trans->rx_data[rx_idx++] = I2C0->RXDATA;            // read data from RX buffer (clears RXDATAV)
+            if (rx_idx < trans->rx_len) {
+                I2C0->CMD = I2C_CMD_ACK;                        // ask for the next byte
+            }
+            else {
+                i2c_state = I2C_STATE_STOP;
+                I2C0->CMD = I2C_CMD_NACK;                       // send NACK to slave
+                I2C0->CMD = I2C_CMD_STOP;                       // send STOP to slave
+            }
+        }
+        else {
+            (void)I2C0->RXDATA;                                 // unexpected byte, discard it
+        }
     }
-    else if ((status & I2C_IF_RXDATAV) && !bit_flag) {
-        bit_flag = true;
-        temp_ls_read = I2C0->RXDOUBLE;
-        I2C0->CMD = I2C_CMD_NACK;                               // send NACK to slave
-        I2C0->CMD = I2C_CMD_STOP;                               // send STOP to slave
+    if (status & I2C_IF_MSTOP) {                                // STOP is on the bus, transaction over
+        I2C0->IFC = I2C_IFC_MSTOP;
+        I2C_Transaction_End(i2c_status);
     }
-#endif
+    ISR_TIMING_END(ISR_I2C0);
 }
@@ -39,9 +39,11 @@
 #include "em_gpio.h"
 #include "em_i2c.h"
 #include "bsp.h"
+#include "sleep.h"
 #include "all.h"
 
 #define I2C_EM_BLOCK 3          // lowest energy mode is 2, so block 3
+#define I2C_ASYNC_EM_BLOCK 2    // I2C master needs HFPERCLK, so block 2 (EM1) while a transaction is in flight
 
 #define I2C_WRITE 0
 #define I2C_READ  1
@@ -61,18 +63,88 @@
 #define USR_REG1_RESET              0x3A
 #define USR_REG1_12BIT_RES          0x3B
 
+/* user register 1 measurement resolution bits (RES1 = bit 7, RES0 = bit 0) */
+#define USR_REG1_RES_MASK           0x81
+#define USR_REG1_RES_14BIT          0x00        // RH 12 bit, temp 14 bit
+#define USR_REG1_RES_12BIT          0x01        // RH  8 bit, temp 12 bit
+#define USR_REG1_RES_13BIT          0x80        // RH 10 bit, temp 13 bit
+#define USR_REG1_RES_11BIT          0x81        // RH 11 bit, temp 11 bit
+
 
 #define CORE_FREQUENCY              14000000
 #define I2C_SLAVE_ADDRESS           0x40
 #define I2C_RXBUFFER_SIZE           20
+#define I2C_TIMEOUT_MS              50          // a transaction is aborted after this, a Si7021 hold conversion stretches SCL up to 11 ms
+
+/******************************************************************************
+ * @brief Result handed to a transaction's completion callback
+ *****************************************************************************/
+typedef enum {
+    I2C_STATUS_DONE,            // all bytes written/read and STOP sent
+    I2C_STATUS_NACK,            // slave NACKed the address or a data byte
+    I2C_STATUS_BUS_ERROR,       // misplaced START/STOP or arbitration lost, transfer aborted
+    I2C_STATUS_TIMEOUT,         // not finished within I2C_TIMEOUT_MS (e.g. SCL held low), aborted
+} I2C_Status;
+
+/******************************************************************************
+ * @brief States of the interrupt driven master state machine
+ *****************************************************************************/
+typedef enum {
+    I2C_STATE_IDLE,             // no transaction in flight
+    I2C_STATE_ADDR_W,           // START + address/WRITE sent, waiting for ACK
+    I2C_STATE_TX_DATA,          // write byte sent, waiting for ACK
+    I2C_STATE_ADDR_R,           // (repeated) START + address/READ sent, waiting for ACK
+    I2C_STATE_RX_DATA,          // waiting for RXDATAV
+    I2C_STATE_STOP,             // STOP sent, waiting for MSTOP
+} I2C_State;
+
+typedef struct I2C_Transaction I2C_Transaction;
+
+/******************************************************************************
+ * @brief Transaction descriptor: write tx_len bytes, then (repeated START) read
+ *        rx_len bytes. Either length may be 0, with both 0 only the address
+ *        (WRITE) and a STOP are sent to probe the slave. rx_data may be NULL
+ *        if rx_len is 0. Must stay valid until callback.
+ *****************************************************************************/
+struct I2C_Transaction {
+    uint8_t         slave_addr;                                         // 7 bit slave address
+    const uint8_t * tx_data;                                            // bytes to write after address/WRITE
+    uint8_t         tx_len;
+    uint8_t *       rx_data;                                            // destination for bytes read
+    uint8_t         rx_len;
+    void (*callback)(I2C_Transaction * trans, I2C_Status status);       // called from I2C0_IRQHandler, may be NULL
+};
 
 void I2C_Setup(void);
 void I2C_Reset_Bus(void);
 void I2C_Write_to_Reg_NoInterrupts(uint8_t slave_addr_rw, uint8_t cmd, uint8_t data);
 uint8_t I2C_Read_from_Reg_NoInterrupts(uint8_t slave_addr_rw, uint8_t cmd);
 void I2C_Write_Interrupts(uint8_t slave_addr, uint8_t cmd, uint8_t data);
-void I2C_Read_Interrupts(uint8_t slave_addr, uint8_t cmd);
+uint8_t I2C_Read_Interrupts(uint8_t slave_addr, uint8_t cmd);
 void I2C_Interrupt_Enable(void);
 void I2C_Interrupt_Disable(void);
 
+/******************************************************************************
+ * @brief Start an interrupt driven transaction and return immediately
+ * @param trans: descriptor to run, owned by the caller until its callback
+ * @return false if another transaction is still in flight
+ *****************************************************************************/
+bool I2C_Transaction_Submit(I2C_Transaction * trans);
+
+/******************************************************************************
+ * @brief Check if a transaction is in flight
+ * @param none
+ * @return true until the STOP of the current transaction has been sent
+ *****************************************************************************/
+bool I2C_Transaction_Busy(void);
+
+/******************************************************************************
+ * @brief Sleep in EM1 until the current transaction completes or is aborted,
+ *        at most I2C_TIMEOUT_MS. Must not be called from an ISR that can't be
+ *        preempted by I2C0_IRQHandler and RTCC_IRQHandler
+ * @param none
+ * @return none
+ *****************************************************************************/
+void I2C_Transaction_Wait(void);
+
 #endif /* I2C_H_ */
@@ -1,9 +1,30 @@
 #include "i2ctemp.h"
 #include "i2c.h"
+#include "gpio.h"
+#include "main.h"
+#include "timer.h"
+#include "scheduler.h"
+#include "vtimer.h"
+#include "rtcc.h"
+#include "delay.h"
+
+volatile uint16_t temp_ms_read;
+volatile uint16_t temp_ls_read;
+static volatile bool temp_read_ok;
+static uint8_t fetch_retries;
+uint8_t si7021_user_reg1 = USR_REG1_RESET;                  // resolution currently configured in the sensor
+
+static uint8_t temp_cmd;
+static uint8_t temp_data[2];
+static Temp_Read_Callback temp_callback;
+
+static void Temp_Transaction_Done(I2C_Transaction * trans, I2C_Status status);
+static I2C_Transaction temp_trans = { I2C_SLAVE_ADDRESS, &temp_cmd, 1, temp_data, 2, Temp_Transaction_Done };
+
+static uint8_t temp_config[2] = { USER_REG_1_W, USR_REG1_RESET };
+static void Temp_Config_Done(I2C_Transaction * trans, I2C_Status status);
+static I2C_Transaction temp_config_trans = { I2C_SLAVE_ADDRESS, temp_config, 2, NULL, 0, Temp_Config_Done };
 
-volatile bool ACK_done;
-extern volatile uint16_t temp_ms_read;
-extern volatile uint16_t temp_ls_read;
 /******************************************************************************
  * @brief Read temperature from si7021 slave device without interrupts
  * @param slave_addr_rw = address of slave device, cmd = command to send to slave
@@ -35,34 +56,261 @@ void I2C_Temperature_Read_NoInterrupts(uint8_t slave_addr_rw, uint8_t cmd) {
     I2C0->CMD = I2C_CMD_STOP;
 }
 /******************************************************************************
- * @brief Read temperature from si7021 slave device with interrupts
+ * @brief Completion of temp_trans, publish the two bytes read
+ * @param trans = temp_trans, status = result of the transaction
+ * @return temp_ms/ls_read returns most and least significant data chunks
+ *****************************************************************************/
+static void Temp_Transaction_Done(I2C_Transaction * trans, I2C_Status status) {
+    if ((status == I2C_STATUS_DONE) && (trans->rx_len == 2)) {
+        temp_ms_read = temp_data[0];
+        temp_ls_read = temp_data[1];
+    }
+    if (temp_callback) {
+        temp_callback(status == I2C_STATUS_DONE);
+    }
+}
+/******************************************************************************
+ * @brief Start a non-blocking temperature read from si7021 slave device
+ * @param slave_addr_rw = address of slave device, cmd = command to send to slave,
+ *        callback = called once temp_ms/ls_read are valid (may be NULL)
+ * @return false if the I2C engine is busy with another transaction
+ *****************************************************************************/
+bool I2C_Temperature_Read_Async(uint8_t slave_addr_rw, uint8_t cmd, Temp_Read_Callback callback) {
+    if (I2C_Transaction_Busy()) {
+        return false;
+    }
+    temp_cmd              = cmd;
+    temp_callback         = callback;
+    temp_trans.slave_addr = slave_addr_rw;
+    temp_trans.tx_len     = 1;                              // command, repeated START, 2 data bytes
+    temp_trans.rx_len     = 2;
+    return I2C_Transaction_Submit(&temp_trans);
+}
+/******************************************************************************
+ * @brief Start a No-Hold Master measurement: write the command and release
+ *        the bus, the sensor converts on its own afterwards
+ * @param slave_addr_rw = address of slave device, callback = called once the
+ *        command has been sent (may be NULL)
+ * @return false if the I2C engine is busy with another transaction
+ *****************************************************************************/
+bool I2C_Temperature_Start_NoHold(uint8_t slave_addr_rw, Temp_Read_Callback callback) {
+    if (I2C_Transaction_Busy()) {
+        return false;
+    }
+    temp_cmd              = MEAS_TEMP_NO_HOLD;
+    temp_callback         = callback;
+    temp_trans.slave_addr = slave_addr_rw;
+    temp_trans.tx_len     = 1;                              // command only, STOP right after
+    temp_trans.rx_len     = 0;
+    return I2C_Transaction_Submit(&temp_trans);
+}
+/******************************************************************************
+ * @brief Read the result of a No-Hold Master measurement (address + 2 bytes).
+ *        The sensor NACKs its address while the conversion is still running
+ * @param slave_addr_rw = address of slave device, callback = called once
+ *        temp_ms/ls_read are valid or the sensor NACKed (may be NULL)
+ * @return false if the I2C engine is busy with another transaction
+ *****************************************************************************/
+bool I2C_Temperature_Fetch_NoHold(uint8_t slave_addr_rw, Temp_Read_Callback callback) {
+    if (I2C_Transaction_Busy()) {
+        return false;
+    }
+    temp_callback         = callback;
+    temp_trans.slave_addr = slave_addr_rw;
+    temp_trans.tx_len     = 0;                              // address/READ, 2 data bytes
+    temp_trans.rx_len     = 2;
+    return I2C_Transaction_Submit(&temp_trans);
+}
+/******************************************************************************
+ * @brief Worst-case temperature conversion time for a resolution setting
+ * @param user_reg1 = value of (or to be written to) user register 1
+ * @return conversion time in microseconds
+ *****************************************************************************/
+uint32_t Temp_Conversion_Time_us(uint8_t user_reg1) {
+    switch (user_reg1 & USR_REG1_RES_MASK) {
+        case USR_REG1_RES_12BIT: return CONV_TIME_12BIT_US;
+        case USR_REG1_RES_13BIT: return CONV_TIME_13BIT_US;
+        case USR_REG1_RES_11BIT: return CONV_TIME_11BIT_US;
+        default:                 return CONV_TIME_14BIT_US;
+    }
+}
+/******************************************************************************
+ * @brief Read temperature from si7021 slave device with interrupts, sleeping
+ *        in EM1 until the transaction completes
  * @param slave_addr_rw = address of slave device, cmd = command to send to slave
- * @return ACK_done = to clear global acknowledgements for I2C with interrupts
+ * @return temp_ms/ls_read returns most and least significant data chunks
  *****************************************************************************/
 void I2C_Temperature_Read_Interrupts(uint8_t slave_addr_rw, uint8_t cmd) {
-    ACK_done     = 0;
-    I2C0->CMD    = I2C_CMD_START;                           // send START condition to slave
-    I2C0->TXDATA = (slave_addr_rw << 1) | I2C_WRITE;        // send slave addr in upper 7 bits
-                                                            // WRITE bit in LSB to send command before reading
-    while(!ACK_done);
-    ACK_done     = 0;
-    I2C0->TXDATA = cmd;                                     // send command to temp sensor
-    while(!ACK_done);
-    ACK_done     = 0;
-    I2C0->CMD    = I2C_CMD_START;                           // send REPEATED START to slave
-    I2C0->TXDATA = (slave_addr_rw << 1) | I2C_READ;         // send slave addr and READ bit
-    while(!ACK_done);
-    ACK_done = 0;
+    while (!I2C_Temperature_Read_Async(slave_addr_rw, cmd, NULL)) {
+        I2C_Transaction_Wait();                             // wait for any transaction already in flight
+    }
+    I2C_Transaction_Wait();
+}
+/******************************************************************************
+ * @brief Completion of the read started by Temp_Measurement_Start(), runs in
+ *        I2C0_IRQHandler so only records the result and posts the next stage
+ * @param success = false if the Si7021 NACKed
+ * @return CONVERT_TEMP posted
+ *****************************************************************************/
+static void Temp_Measurement_Done(bool success) {
+    temp_read_ok = success;
+    Scheduler_Post(CONVERT_TEMP);
+}
+/******************************************************************************
+ * @brief No-Hold conversion wait elapsed, runs from the RTCC interrupt
+ * @param timer = conversion_timer
+ * @return FETCH_TEMP posted
+ *****************************************************************************/
+static void Temp_Conversion_Elapsed(VTimer * timer) {
+    Scheduler_Post(FETCH_TEMP);
+}
+
+static VTimer conversion_timer = { .callback = Temp_Conversion_Elapsed };
+
+/******************************************************************************
+ * @brief Sleep (EM2) on a virtual timer for the conversion time of the
+ *        configured resolution
+ * @param none
+ * @return none
+ *****************************************************************************/
+static void Temp_Conversion_Wait(void) {
+    VTimer_Start(&conversion_timer, RTCC_US_TO_TICKS(Temp_Conversion_Time_us(si7021_user_reg1)), 0, 0);
+}
+/******************************************************************************
+ * @brief No-Hold command has been sent, wait for the conversion. Runs in
+ *        I2C0_IRQHandler
+ * @param success = false if the Si7021 NACKed the command
+ * @return none
+ *****************************************************************************/
+static void Temp_Conversion_Started(bool success) {
+    if (!success) {
+        Temp_Measurement_Done(false);
+        return;
+    }
+    Temp_Conversion_Wait();                                                // posts FETCH_TEMP when elapsed
 }
 /******************************************************************************
- * @brief Convert temp code from si7021 temp sensor to celsius
- * @param MSData = most significant byte of data from temp sensor,
- *        LSData = least significant byte of data from temp sensor,
- *        DataRet = celsius temp
+ * @brief No-Hold result read finished. A NACK means the conversion is still
+ *        running, so wait once more. Runs in I2C0_IRQHandler
+ * @param success = false if the Si7021 NACKed its address
  * @return none
  *****************************************************************************/
-void Temp_Code_To_Celsius(uint16_t MSData, uint16_t LSData, float * DataRet) {
-    uint16_t Combined_Data1 = 0;
-    Combined_Data1 = (MSData << 8) + LSData;
-    *DataRet = ((175.72 * Combined_Data1) / 65536) - 46.85;
+static void Temp_Fetch_Done(bool success) {
+    if (!success && (fetch_retries++ < NO_HOLD_FETCH_RETRIES)) {
+        Temp_Conversion_Wait();
+        return;
+    }
+    Temp_Measurement_Done(success);
+}
+/******************************************************************************
+ * @brief Submit the temperature read selected in all.h
+ * @param none
+ * @return false if nothing was started (reading disabled or engine busy)
+ *****************************************************************************/
+static bool Temp_Measurement_Issue(void) {
+#ifdef READ_TEMPERATURE
+#ifdef SI7021_NO_HOLD_MODE
+    fetch_retries = 0;
+    return I2C_Temperature_Start_NoHold(I2C_SLAVE_ADDRESS, Temp_Conversion_Started);  // bus is released during conversion
+#else
+    return I2C_Temperature_Read_Async(I2C_SLAVE_ADDRESS, MEAS_TEMP_HOLD, Temp_Measurement_Done);  // sleep in EM1 while sensor converts
+#endif
+#else
+    return false;
+#endif
+}
+/******************************************************************************
+ * @brief User register 1 written, start the measurement. Runs in I2C0_IRQHandler
+ * @param trans = temp_config_trans, status = result of the write
+ * @return none
+ *****************************************************************************/
+static void Temp_Config_Done(I2C_Transaction * trans, I2C_Status status) {
+    if ((status != I2C_STATUS_DONE) || !Temp_Measurement_Issue()) {
+        Temp_Measurement_Done(false);
+    }
+}
+/******************************************************************************
+ * @brief Select the temperature resolution. The Si7021 is powered off between
+ *        samples and forgets user register 1, so a non-default value is
+ *        written again before every measurement
+ * @param bits = 11, 12, 13 or 14
+ * @return false if bits is not a supported resolution
+ *****************************************************************************/
+bool Temp_Set_Resolution(uint8_t bits) {
+    uint8_t res;
+
+    switch (bits) {
+        case 14: res = USR_REG1_RES_14BIT; break;
+        case 13: res = USR_REG1_RES_13BIT; break;
+        case 12: res = USR_REG1_RES_12BIT; break;
+        case 11: res = USR_REG1_RES_11BIT; break;
+        default: return false;
+    }
+    si7021_user_reg1 = (USR_REG1_RESET & ~USR_REG1_RES_MASK) | res;
+    return true;
+}
+/******************************************************************************
+ * @brief Deferred stage 1: route the I2C pins, reset the bus and start a
+ *        non-blocking temperature read. CONVERT_TEMP is posted when it is done
+ * @param none
+ * @return none
+ *****************************************************************************/
+void Temp_Measurement_Start(void) {
+    /* LPM Enable Routine */
+    Sleep_Block_Mode(I2C_EM_BLOCK);                                           // set sleep mode block for master I2C operation
+    GPIO_PinModeSet(SCL_PORT, SCL_PIN, gpioModeWiredAnd, SCL_AND_SDA_DOUT);   // set up GPIO pin PC11 (SCL)
+    GPIO_PinModeSet(SDA_PORT, SDA_PIN, gpioModeWiredAnd, SCL_AND_SDA_DOUT);   // set up GPIO pin PC10 (SDA)
+    for (int i = 0; i < 9; i++) {                                             // reset slave I2C device state machine
+        GPIO_PinOutClear(SCL_PORT, SCL_PIN);
+        GPIO_PinOutSet(SCL_PORT, SCL_PIN);
+    }
+    I2C0->CMD = I2C_CMD_ABORT;                                                // reset pearl gecko I2C state machine
+    I2C0->IFC |= I2C_IFC_ACK;                                                 // clear ACK flag
+#ifdef RW_FROM_REGISTER
+    /* read/write routine */
+    Delay_ms(RW_FROM_REGISTER_DELAY_MS);                                      // sleep instead of spinning
+    I2C_Write_to_Reg_NoInterrupts(I2C_SLAVE_ADDRESS, USER_REG_1_W, USR_REG1_12BIT_RES);
+    si7021_user_reg1 = USR_REG1_12BIT_RES;
+    Delay_ms(RW_FROM_REGISTER_DELAY_MS);
+    I2C_Read_from_Reg_NoInterrupts(I2C_SLAVE_ADDRESS, USER_REG_1_R);          // read data from temp sensor
+    Delay_ms(RW_FROM_REGISTER_DELAY_MS);
+#endif
+
+#ifdef READ_TEMPERATURE
+    if (si7021_user_reg1 != USR_REG1_RESET) {                                 // register reverted at power-up
+        temp_config[1] = si7021_user_reg1;
+        if (I2C_Transaction_Submit(&temp_config_trans)) {                     // measurement follows in Temp_Config_Done
+            return;
+        }
+    }
+    else if (Temp_Measurement_Issue()) {
+        return;
+    }
+#endif
+    Temp_Measurement_Done(false);                                             // nothing to convert, just power down
+}
+/******************************************************************************
+ * @brief Deferred stage 1b (No-Hold mode): read the result once the
+ *        conversion wait armed in stage 1 has elapsed. CONVERT_TEMP is posted
+ *        when it is done
+ * @param none
+ * @return none
+ *****************************************************************************/
+void Temp_Measurement_Fetch(void) {
+    if (!I2C_Temperature_Fetch_NoHold(I2C_SLAVE_ADDRESS, Temp_Fetch_Done)) {
+        Temp_Measurement_Done(false);
+    }
+}
+/******************************************************************************
+ * @brief Deferred stage 2: release the I2C pins and power off the Si7021
+ * @param none
+ * @return true if temp_ms/ls_read hold a new reading
+ *****************************************************************************/
+bool Temp_Measurement_Finish(void) {
+    /* LPM Disable Routine */
+    GPIO_PinModeSet(SCL_PORT, SCL_PIN, gpioModeDisabled, SCL_AND_SDA_DOUT);   // disable GPIO pin PC11 (SCL)
+    GPIO_PinModeSet(SDA_PORT, SDA_PIN, gpioModeDisabled, SCL_AND_SDA_DOUT);   // disable GPIO pin PC10 (SDA)
+    GPIO->P[SENS_EN_PORT].DOUT &= ~(1 << SENS_EN_PIN);                        // turn off temp sensor
+    Sleep_UnBlock_Mode(I2C_EM_BLOCK);                                         // unblock sleep mode setting for I2C
+    return temp_read_ok;
 }
@@ -40,6 +40,24 @@
 #include "em_i2c.h"
 #include "bsp.h"
 #include "all.h"
+#include "i2c.h"
+#include "tempconv.h"
+
+/* max temperature conversion times from the Si7021-A20 datasheet (table 2) */
+#define CONV_TIME_14BIT_US          10800
+#define CONV_TIME_13BIT_US           6200
+#define CONV_TIME_12BIT_US           3800
+#define CONV_TIME_11BIT_US           2400
+
+#define NO_HOLD_FETCH_RETRIES           3       // re-arm the conversion wait this often if the read is NACKed
+#define RW_FROM_REGISTER_DELAY_MS      25       // settle time around the blocking register access
+
+/******************************************************************************
+ * @brief Temperature read completion callback, runs in I2C0_IRQHandler
+ * @param success = false if the sensor NACKed
+ *****************************************************************************/
+typedef void (*Temp_Read_Callback)(bool success);
+
 /******************************************************************************
  * @brief Read temperature from si7021 slave device without interrupts
  * @param slave_addr_rw = address of slave device, cmd = command to send to slave
@@ -48,19 +66,78 @@
 void I2C_Temperature_Read_NoInterrupts(uint8_t slave_addr_rw, uint8_t cmd);
 
 /******************************************************************************
- * @brief Read temperature from si7021 slave device with interrupts
+ * @brief Read temperature from si7021 slave device with interrupts, sleeping
+ *        in EM1 until the transaction completes
  * @param slave_addr_rw = address of slave device, cmd = command to send to slave
- * @return ACK_done = to clear global acknowledgements for I2C with interrupts
+ * @return temp_ms/ls_read returns most and least significant data chunks
  *****************************************************************************/
 void I2C_Temperature_Read_Interrupts(uint8_t slave_addr_rw, uint8_t cmd);
 
 /******************************************************************************
- * @brief Convert temp code from si7021 temp sensor to celsius
- * @param MSData = most significant byte of data from temp sensor,
- *        LSData = least significant byte of data from temp sensor,
- *        DataRet = celsius temp
+ * @brief Start a non-blocking temperature read from si7021 slave device
+ * @param slave_addr_rw = address of slave device, cmd = command to send to slave,
+ *        callback = called once temp_ms/ls_read are valid (may be NULL)
+ * @return false if the I2C engine is busy with another transaction
+ *****************************************************************************/
+bool I2C_Temperature_Read_Async(uint8_t slave_addr_rw, uint8_t cmd, Temp_Read_Callback callback);
+
+/******************************************************************************
+ * @brief Start a No-Hold Master measurement: write the command and release
+ *        the bus, the sensor converts on its own afterwards
+ * @param slave_addr_rw = address of slave device, callback = called once the
+ *        command has been sent (may be NULL)
+ * @return false if the I2C engine is busy with another transaction
+ *****************************************************************************/
+bool I2C_Temperature_Start_NoHold(uint8_t slave_addr_rw, Temp_Read_Callback callback);
+
+/******************************************************************************
+ * @brief Read the result of a No-Hold Master measurement (address + 2 bytes).
+ *        The sensor NACKs its address while the conversion is still running
+ * @param slave_addr_rw = address of slave device, callback = called once
+ *        temp_ms/ls_read are valid or the sensor NACKed (may be NULL)
+ * @return false if the I2C engine is busy with another transaction
+ *****************************************************************************/
+bool I2C_Temperature_Fetch_NoHold(uint8_t slave_addr_rw, Temp_Read_Callback callback);
+
+/******************************************************************************
+ * @brief Worst-case temperature conversion time for a resolution setting
+ * @param user_reg1 = value of (or to be written to) user register 1
+ * @return conversion time in microseconds
+ *****************************************************************************/
+uint32_t Temp_Conversion_Time_us(uint8_t user_reg1);
+
+/******************************************************************************
+ * @brief Select the temperature resolution. The Si7021 is powered off between
+ *        samples and forgets user register 1, so a non-default value is
+ *        written again before every measurement
+ * @param bits = 11, 12, 13 or 14
+ * @return false if bits is not a supported resolution
+ *****************************************************************************/
+bool Temp_Set_Resolution(uint8_t bits);
+
+
+/******************************************************************************
+ * @brief Deferred stage 1: route the I2C pins, reset the bus and start a
+ *        non-blocking temperature read. CONVERT_TEMP is posted when it is done
+ * @param none
  * @return none
  *****************************************************************************/
-void Temp_Code_To_Celsius(uint16_t MSData, uint16_t LSData, float * DataRet);
+void Temp_Measurement_Start(void);
+
+/******************************************************************************
+ * @brief Deferred stage 1b (No-Hold mode): read the result once the
+ *        conversion wait armed in stage 1 has elapsed. CONVERT_TEMP is posted
+ *        when it is done
+ * @param none
+ * @return none
+ *****************************************************************************/
+void Temp_Measurement_Fetch(void);
+
+/******************************************************************************
+ * @brief Deferred stage 2: release the I2C pins and power off the Si7021
+ * @param none
+ * @return true if temp_ms/ls_read hold a new reading
+ *****************************************************************************/
+bool Temp_Measurement_Finish(void);
 
 #endif /* SRC_I2CTEMP_H_ */
@@ -0,0 +1,26 @@
+#include "isrtime.h"
+
+volatile uint32_t isr_max_cycles[ISR_COUNT];
+
+/******************************************************************************
+ * @brief Enable the DWT cycle counter and clear all recorded maximums
+ * @param none
+ * @return none
+ *****************************************************************************/
+void ISR_Timing_Init(void) {
+    for (int i = 0; i < ISR_COUNT; i++) {
+        isr_max_cycles[i] = 0;
+    }
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;              // enable trace block so DWT is clocked
+    DWT->CYCCNT = 0;
+    DWT->CTRL  |= DWT_CTRL_CYCCNTENA_Msk;                       // start the free running cycle counter
+}
+
+/******************************************************************************
+ * @brief Get the worst-case execution time of an interrupt handler
+ * @param id = handler to query
+ * @return worst-case execution time in core clock cycles
+ *****************************************************************************/
+uint32_t ISR_Timing_Max(ISR_Id id) {
+    return isr_max_cycles[id];
+}
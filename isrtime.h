@@ -0,0 +1,90 @@
+/**************************************************************************//**
+ * @file isrtime.h
+ * @brief Worst-case interrupt handler execution time header
+ * @author Silicon Labs
+ * @version 1.00
+ ******************************************************************************
+ * @section License
+ * <b>(C) Copyright 2014 Silicon Labs, http://www.silabs.com</b>
+ *******************************************************************************
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ * DISCLAIMER OF WARRANTY/LIMITATION OF REMEDIES: Silicon Labs has no
+ * obligation to support this Software. Silicon Labs is providing the
+ * Software "AS IS", with no express or implied warranties of any kind,
+ * including, but not limited to, any implied warranties of merchantability
+ * or fitness for any particular purpose or warranties against infringement
+ * of any proprietary rights of a third party.
+ *
+ * Silicon Labs will not be liable for any consequential, incidental, or
+ * special damages, or any other relief, or for any claim by any third party,
+ * arising from your use of this Software.
+ *
+ ******************************************************************************/
+
+#ifndef SRC_ISRTIME_H_
+#define SRC_ISRTIME_H_
+
+#include <stdint.h>
+#include "em_device.h"
+#include "all.h"
+
+/******************************************************************************
+ * @brief Interrupt handlers that record their execution time
+ *****************************************************************************/
+typedef enum {
+    ISR_LETIMER0,
+    ISR_I2C0,
+    ISR_LEUART0,
+    ISR_LDMA,
+    ISR_RTCC,
+    ISR_TIMER0,
+    ISR_LESENSE,
+    ISR_COUNT
+} ISR_Id;
+
+extern volatile uint32_t isr_max_cycles[ISR_COUNT];
+
+#ifdef ISR_TIMING
+#define ISR_TIMING_START()    uint32_t isr_start_cycles = DWT->CYCCNT
+#define ISR_TIMING_END(id)    ISR_Timing_Record((id), DWT->CYCCNT - isr_start_cycles)
+#else
+#define ISR_TIMING_START()
+#define ISR_TIMING_END(id)
+#endif
+
+/******************************************************************************
+ * @brief Keep the worst-case execution time of an interrupt handler
+ * @param id = handler being measured, cycles = core cycles it took
+ * @return isr_max_cycles[id] updated if cycles is a new maximum
+ *****************************************************************************/
+static inline void ISR_Timing_Record(ISR_Id id, uint32_t cycles) {
+    if (cycles > isr_max_cycles[id]) {
+        isr_max_cycles[id] = cycles;
+    }
+}
+
+/******************************************************************************
+ * @brief Enable the DWT cycle counter and clear all recorded maximums
+ * @param none
+ * @return none
+ *****************************************************************************/
+void ISR_Timing_Init(void);
+
+/******************************************************************************
+ * @brief Get the worst-case execution time of an interrupt handler
+ * @param id = handler to query
+ * @return worst-case execution time in core clock cycles
+ *****************************************************************************/
+uint32_t ISR_Timing_Max(ISR_Id id);
+
+#endif /* SRC_ISRTIME_H_ */
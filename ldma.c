@@ -1,13 +1,24 @@
 #include "ldma.h"
 #include "em_ldma.h"
 #include "uart.h"
+#include "isrtime.h"
+#include <em_core.h>
 
-int8_t TxBuffer[TX_BUFFER_SIZE];
-LDMA_Descriptor_t  ldmaTXDescriptor;
+static uint8_t  tx_slot_data[TX_QUEUE_DEPTH][TX_SLOT_SIZE];      // message slots, DMA source buffers
+static uint8_t  tx_slot_len[TX_QUEUE_DEPTH];
+static LDMA_Descriptor_t tx_descriptors[TX_QUEUE_DEPTH];        // tx_descriptors[i] always moves tx_slot_data[i]
+static volatile uint8_t  tx_head;                               // oldest queued slot
+static volatile uint8_t  tx_count;                              // queued slots, including in flight
+static volatile uint8_t  tx_in_flight;                          // slots covered by the running chain
+static volatile bool     tx_busy;                               // LEUART_EM_BLOCK held until TXC
+static bool              tx_reserved;                           // slot (tx_head + tx_count) handed out by LDMA_TX_Reserve
+static volatile bool     tx_hold;                               // LDMA_TX_Hold(): queue commits, don't start a chain
+static volatile uint32_t tx_drops;
 LDMA_TransferCfg_t ldmaTXConfig;
+static uint8_t  rx_ring[RX_RING_SIZE];                          // filled forever by the looping RX descriptor
+static uint8_t  rx_read_idx;                                    // next byte to hand out, owned by the reader
 LDMA_Descriptor_t  ldmaRXDescriptor;
 LDMA_TransferCfg_t ldmaRXConfig;
-extern char receive_buffer[RECEIVE_BUFFER_SIZE];
 
 /******************************************************************************
  * @brief Initialize LDMA peripheral
@@ -19,11 +30,22 @@ void LDMA_Setup(void) {
     LDMA_Init(&ldmaInit);                               // Passing above into predefined function
     Sleep_Block_Mode(LEUART_EM_BLOCK);
 
-    // LDMA descriptor and config for transferring TxBuffer
-    ldmaTXDescriptor = (LDMA_Descriptor_t)LDMA_DESCRIPTOR_SINGLE_M2P_BYTE(TxBuffer, &(LEUART0->TXDATA), TX_BUFFER_SIZE); // Source: TxBuffer, Destination: USART1->TXDATA, Bytes to send: 10
+    // LDMA descriptors and config for transferring the TX slots
+    for (int i = 0; i < TX_QUEUE_DEPTH; i++) {
+        tx_descriptors[i] = (LDMA_Descriptor_t)LDMA_DESCRIPTOR_LINKABS_M2P_BYTE(tx_slot_data[i], &(LEUART0->TXDATA), TX_SLOT_SIZE);
+        tx_descriptors[i].xfer.doneIfs = 0;             // one DONE interrupt per chain, set on the last descriptor
+    }
+    tx_head = 0;
+    tx_count = 0;
+    tx_in_flight = 0;
+    tx_busy = false;
+    tx_reserved = false;
     ldmaTXConfig = (LDMA_TransferCfg_t)LDMA_TRANSFER_CFG_PERIPHERAL(ldmaPeripheralSignal_LEUART0_TXBL);                  // or ldmaPeripheralSignal_LEUART0_TXEMPTY?
 
-    ldmaRXDescriptor = (LDMA_Descriptor_t)LDMA_DESCRIPTOR_SINGLE_P2M_BYTE(&(LEUART0->RXDATA), receive_buffer, RECEIVE_BUFFER_SIZE);
+    // RX descriptor links to itself (relative jump 0): rx_ring is refilled forever without CPU involvement
+    ldmaRXDescriptor = (LDMA_Descriptor_t)LDMA_DESCRIPTOR_LINKREL_P2M_BYTE(&(LEUART0->RXDATA), rx_ring, RX_RING_SIZE, 0);
+    ldmaRXDescriptor.xfer.doneIfs = 0;                  // no interrupt when the ring wraps
+    rx_read_idx = 0;
     ldmaRXConfig = (LDMA_TransferCfg_t)LDMA_TRANSFER_CFG_PERIPHERAL(ldmaPeripheralSignal_LEUART0_RXDATAV);
 
     LEUART0->CTRL |= LEUART_CTRL_RXDMAWU;               // DMA Wakeup
@@ -32,45 +54,211 @@ void LDMA_Setup(void) {
     LDMA_StartTransfer(RX_DMA_CHANNEL, &ldmaRXConfig, &ldmaRXDescriptor);
 }
 /******************************************************************************
- * @brief Convert temperature from a float to an ASCII value and put into buffer 
-          to prepare for DMA transfer
- * @param number = number to convert to ASCII
- * @return TxBuffer = global array that holds decoded converted value
- *****************************************************************************/ 
-void LDMA_ftoa_send(float number) {                     // convert float to ascii value and send via UART
-    int16_t integer = (int16_t)number;
-    uint16_t decimal;
+ * @brief Link every queued slot from tx_head into one descriptor chain and
+ *        start it. Must be called with interrupts disabled and no chain running
+ * @param none
+ * @return tx_in_flight = number of slots in the chain
+ *****************************************************************************/
+static void LDMA_TX_Start_Chain(void) {
+    uint8_t slot = tx_head;
 
-    if(integer < 0) {                                   // test if negative
-        TxBuffer[Tx0] = NEGATIVE_SIGN;                  // send negative sign
-        decimal = (((-1) * (number - integer)) * 10);   // find decimal value
-        integer = -1 * integer;                         // make value positive for all following operations
+    for (uint8_t i = 0; i < tx_count; i++) {
+        uint8_t next = (slot + 1) % TX_QUEUE_DEPTH;
+        tx_descriptors[slot].xfer.xferCnt = tx_slot_len[slot] - 1;      // LDMA transfers xferCnt + 1 units
+        if (i < tx_count - 1) {
+            tx_descriptors[slot].xfer.link     = 1;
+            tx_descriptors[slot].xfer.linkAddr = (uint32_t)&tx_descriptors[next] >> 2;
+            tx_descriptors[slot].xfer.doneIfs  = 0;
+        }
+        else {
+            tx_descriptors[slot].xfer.link     = 0;                     // last queued message ends the chain
+            tx_descriptors[slot].xfer.doneIfs  = 1;
+        }
+        slot = next;
     }
-    else {
-        TxBuffer[Tx0] = POSITIVE_SIGN;                  // send positive sign
-        decimal = ((number - integer) * 10);            // find decimal values
+    tx_in_flight = tx_count;
+
+    if (!tx_busy) {
+        tx_busy = true;
+        Sleep_Block_Mode(LEUART_EM_BLOCK);              // released by LEUART TXC after the last byte
     }
-    if(((integer % 1000) / 100) != 0) {                 // hundreds place
-        TxBuffer[Tx1] = ((integer / 100) + ASCII_OFFSET);
+    LEUART0->CTRL |= LEUART_CTRL_TXDMAWU;               // DMA Wakeup
+    LDMA_StartTransfer(TX_DMA_CHANNEL, &ldmaTXConfig, &tx_descriptors[tx_head]);
+}
+/******************************************************************************
+ * @brief Ring index the RX channel will write next, from its destination
+ *        address (equals RX_RING_SIZE for a moment before the descriptor reloads)
+ * @param none
+ * @return write index (0 - RX_RING_SIZE - 1)
+ *****************************************************************************/
+static uint8_t LDMA_RX_Write_Index(void) {
+    return (LDMA->CH[RX_DMA_CHANNEL].DST - (uint32_t)rx_ring) % RX_RING_SIZE;
+}
+/******************************************************************************
+ * @brief Number of received bytes in the RX ring not read yet. The write
+ *        index is the LDMA destination address, no interrupt per byte
+ * @param none
+ * @return bytes available (0 - RX_RING_SIZE - 1)
+ *****************************************************************************/
+uint8_t LDMA_RX_Available(void) {
+    return (LDMA_RX_Write_Index() - rx_read_idx + RX_RING_SIZE) % RX_RING_SIZE;
+}
+/******************************************************************************
+ * @brief Read the next received byte from the RX ring
+ * @param data = where to store the byte
+ * @return false if no byte is available
+ *****************************************************************************/
+bool LDMA_RX_Read(uint8_t * data) {
+    if (rx_read_idx == LDMA_RX_Write_Index()) {         // more than RX_RING_SIZE unread bytes are overwritten
+        return false;
     }
-    else {
-        TxBuffer[Tx1] = 0x20;                           // if 0 value, send space instead
+    *data = rx_ring[rx_read_idx];
+    rx_read_idx = (rx_read_idx + 1) % RX_RING_SIZE;
+    return true;
+}
+/******************************************************************************
+ * @brief Reserve the next idle TX slot so a producer can format straight into
+ *        it while the DMA drains the committed ones. Only one slot can be
+ *        reserved at a time (single producer: the main loop)
+ * @param none
+ * @return slot buffer of TX_SLOT_SIZE bytes, NULL if the queue is full
+ *****************************************************************************/
+uint8_t * LDMA_TX_Reserve(void) {
+    uint8_t slot;
+    CORE_DECLARE_IRQ_STATE;
+
+    CORE_ENTER_CRITICAL();
+    if (tx_reserved || (tx_count == TX_QUEUE_DEPTH)) {  // every other slot is queued or in flight
+        tx_drops++;
+        CORE_EXIT_CRITICAL();
+        return NULL;
+    }
+    slot = (tx_head + tx_count) % TX_QUEUE_DEPTH;       // first slot past the queue, DONE_CH1 never touches it
+    tx_reserved = true;
+    CORE_EXIT_CRITICAL();
+    return tx_slot_data[slot];
+}
+/******************************************************************************
+ * @brief Hand the reserved slot to the DMA. The DMA never sees a slot before
+ *        it is committed, so frames can't be torn
+ * @param length = bytes written into the reserved slot, 0 to release it unused
+ * @return false if length is over TX_SLOT_SIZE, the slot is released and the
+ *         message counted as dropped
+ *****************************************************************************/
+bool LDMA_TX_Commit(uint8_t length) {
+    uint8_t slot;
+    CORE_DECLARE_IRQ_STATE;
+
+    CORE_ENTER_CRITICAL();
+    tx_reserved = false;
+    if (length > TX_SLOT_SIZE) {
+        tx_drops++;                                     // the producer overran the slot, don't send a torn frame
+        CORE_EXIT_CRITICAL();
+        return false;
+    }
+    if (length == 0) {
+        CORE_EXIT_CRITICAL();
+        return true;
+    }
+    slot = (tx_head + tx_count) % TX_QUEUE_DEPTH;       // head only moves forward by whole chains, slot is unchanged
+    tx_slot_len[slot] = length;
+    tx_count++;
+    if ((tx_in_flight == 0) && !tx_hold) {              // DMA idle, otherwise DONE_CH1 picks it up
+        LDMA_TX_Start_Chain();
+    }
+    CORE_EXIT_CRITICAL();
+    return true;
+}
+/******************************************************************************
+ * @brief Hold back the DMA so the slots committed next go out as one burst
+ *        (one descriptor chain) once LDMA_TX_Release() is called
+ * @param none
+ * @return none
+ *****************************************************************************/
+void LDMA_TX_Hold(void) {
+    tx_hold = true;
+}
+/******************************************************************************
+ * @brief End LDMA_TX_Hold(), start a chain over every queued slot if the
+ *        DMA is idle
+ * @param none
+ * @return none
+ *****************************************************************************/
+void LDMA_TX_Release(void) {
+    CORE_DECLARE_IRQ_STATE;
+
+    CORE_ENTER_CRITICAL();
+    tx_hold = false;
+    if ((tx_in_flight == 0) && tx_count) {
+        LDMA_TX_Start_Chain();
     }
-    if((((integer % 100) / 10) != 0) || (((integer % 1000) / 100) != 0)) {  // tens place
-        TxBuffer[Tx2] = (((integer % 100) / 10) + ASCII_OFFSET);
+    CORE_EXIT_CRITICAL();
+}
+/******************************************************************************
+ * @brief Copy a message into a free TX slot. If the DMA is idle a linked
+ *        descriptor chain over every queued slot is started
+ * @param data = bytes to send, length = 1 to TX_SLOT_SIZE bytes
+ * @return false if the message was dropped (queue full or too long)
+ *****************************************************************************/
+bool LDMA_TX_Enqueue(const uint8_t * data, uint8_t length) {
+    uint8_t * slot;
+
+    if (length == 0) {
+        return false;
     }
-    else {
-        TxBuffer[Tx2] = 0x20;                           // if 0 value, send space instead
+    if (length > TX_SLOT_SIZE) {
+        CORE_ATOMIC_SECTION(tx_drops++;)
+        return false;
     }
-    if(((integer % 10) != 0) || (((integer % 1000) / 100) != 0) || (((integer % 100) / 10) != 0)) {  // ones place
-        TxBuffer[Tx3] = ((integer % 10) + ASCII_OFFSET);
+    slot = LDMA_TX_Reserve();
+    if (slot == NULL) {
+        return false;
     }
-    else {
-        TxBuffer[Tx3] = SPACE;                          // if 0 value, send space instead
+    for (uint8_t i = 0; i < length; i++) {
+        slot[i] = data[i];
     }
+    return LDMA_TX_Commit(length);
+}
+/******************************************************************************
+ * @brief Number of queued messages, including the ones being transmitted
+ * @param none
+ * @return queue depth (0 - TX_QUEUE_DEPTH)
+ *****************************************************************************/
+uint8_t LDMA_TX_Queue_Depth(void) {
+    return tx_count;
+}
+/******************************************************************************
+ * @brief Check whether anything is still queued or being shifted out
+ * @param none
+ * @return true until the last byte of the last chain has left the LEUART
+ *****************************************************************************/
+bool LDMA_TX_Busy(void) {
+    return tx_busy || (tx_count != 0);
+}
+/******************************************************************************
+ * @brief Number of messages dropped because the queue was full or they were
+ *        longer than a slot
+ * @param none
+ * @return drop counter since reset
+ *****************************************************************************/
+uint32_t LDMA_TX_Drops(void) {
+    return tx_drops;
+}
+/******************************************************************************
+ * @brief Called on LEUART TXC: release the LEUART energy mode block if no new
+ *        chain has been started since the last one finished
+ * @param none
+ * @return none
+ *****************************************************************************/
+void LDMA_TX_Idle(void) {
+    CORE_DECLARE_IRQ_STATE;
 
-    TxBuffer[Tx4] = DECIMAL_POINT;                      // decimal point
-    TxBuffer[Tx5] = decimal + ASCII_OFFSET;             // tenths place
+    CORE_ENTER_CRITICAL();
+    if (tx_busy && (tx_in_flight == 0)) {
+        tx_busy = false;
+        Sleep_UnBlock_Mode(LEUART_EM_BLOCK);
+    }
+    CORE_EXIT_CRITICAL();
 }
 /******************************************************************************
  * @brief enable LDMA interrupts
@@ -79,8 +267,7 @@ void LDMA_ftoa_send(float number) {                     // convert float to asci
  *****************************************************************************/
 void LDMA_Interrupt_Enable(void) {
     LDMA->IEN = 0;                                      // Clear LDMA Interrupt Enable
-    LDMA->IEN |= LDMA_IEN_DONE_CH0 |
-                 LDMA_IEN_DONE_CH1;                     // Set Ch1 LDMA Interrupt Enable
+    LDMA->IEN |= LDMA_IEN_DONE_CH1;                     // Set Ch1 LDMA Interrupt Enable (RX ring never completes)
     NVIC_EnableIRQ(LDMA_IRQn);                          // Enable Interrupts
 }
 /******************************************************************************
@@ -89,15 +276,23 @@ void LDMA_Interrupt_Enable(void) {
  * @return none
  *****************************************************************************/
 void LDMA_IRQHandler(void){
+    ISR_TIMING_START();
     uint32_t status;
     status = LDMA->IF & LDMA->IEN;
-    if(status & LDMA_IF_DONE_CH0) {                     // when DMA transfer for channel 0 is done
-        LDMA->IFC |= LDMA_IFC_DONE_CH0;                 // Clear Channel 0 IF
-        LEUART0->CTRL &= ~LEUART_CTRL_RXDMAWU;          // DMA Nighty night
-    }
-    if(status & LDMA_IF_DONE_CH1) {                     // when DMA transfer for channel 1 is done
+    if(status & LDMA_IF_DONE_CH1) {                     // when the TX descriptor chain is done
         LDMA->IFC |= LDMA_IFC_DONE_CH1;                 // Clear Channel 1 IF
-        LEUART0->CTRL &= ~LEUART_CTRL_TXDMAWU;          // DMA Nighty night
-        LEUART0->IEN |= LEUART_IEN_TXC;                 // enable TXC interrupt to signify when last byte tx is complete
+        /* swap: the sent slots become idle, the slots committed meanwhile become the next chain */
+        tx_head = (tx_head + tx_in_flight) % TX_QUEUE_DEPTH;    // free the slots that were sent
+        tx_count -= tx_in_flight;
+        tx_in_flight = 0;
+        if(tx_count && !tx_hold) {                      // messages queued while the chain ran
+            LDMA_TX_Start_Chain();
+        }
+        else {
+            LEUART0->CTRL &= ~LEUART_CTRL_TXDMAWU;      // DMA Nighty night
+            LEUART0->IFC = LEUART_IFC_TXC;              // drop a stale TXC from before the last byte
+            LEUART0->IEN |= LEUART_IEN_TXC;             // enable TXC interrupt to signify when last byte tx is complete
+        }
     }
+    ISR_TIMING_END(ISR_LDMA);
 }
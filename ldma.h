@@ -45,18 +45,9 @@
 #define LDMA_IF_DONE_CH1   2
 #define LDMA_IFC_DONE_CH1  2
 
-/******************************************************************************
- * @brief Different array indexes
- *****************************************************************************/
-enum TXBufferIdx {
-    Tx0,
-    Tx1,
-    Tx2,
-    Tx3,
-    Tx4,
-    Tx5,
-    Tx6,
-};
+#define RX_RING_SIZE       32               // bytes, must hold the longest command frame
+#define TX_QUEUE_DEPTH     8                // message slots, one linked descriptor each
+#define TX_SLOT_SIZE       TX_BUFFER_SIZE   // longest message a slot holds
 
 /******************************************************************************
  * @brief Initialize LDMA peripheral
@@ -71,11 +62,90 @@ void LDMA_Setup(void);
  *****************************************************************************/
 void LDMA_Interrupt_Enable(void);
 /******************************************************************************
- * @brief Convert temperature from a float to an ASCII value and put into buffer 
-          to prepare for DMA transfer
- * @param number = number to convert to ASCII
+ * @brief Copy a message into a free TX slot. If the DMA is idle a linked
+ *        descriptor chain over every queued slot is started
+ * @param data = bytes to send, length = 1 to TX_SLOT_SIZE bytes
+ * @return false if the message was dropped (queue full or too long)
+ *****************************************************************************/
+bool LDMA_TX_Enqueue(const uint8_t * data, uint8_t length);
+
+/******************************************************************************
+ * @brief Number of received bytes in the RX ring not read yet. The write
+ *        index is the LDMA destination address, no interrupt per byte
+ * @param none
+ * @return bytes available (0 - RX_RING_SIZE - 1)
+ *****************************************************************************/
+uint8_t LDMA_RX_Available(void);
+
+/******************************************************************************
+ * @brief Read the next received byte from the RX ring
+ * @param data = where to store the byte
+ * @return false if no byte is available
+ *****************************************************************************/
+bool LDMA_RX_Read(uint8_t * data);
+
+/******************************************************************************
+ * @brief Reserve the next idle TX slot so a producer can format straight into
+ *        it while the DMA drains the committed ones. Only one slot can be
+ *        reserved at a time (single producer: the main loop)
+ * @param none
+ * @return slot buffer of TX_SLOT_SIZE bytes, NULL if the queue is full
+ *****************************************************************************/
+uint8_t * LDMA_TX_Reserve(void);
+
+/******************************************************************************
+ * @brief Hand the reserved slot to the DMA. The DMA never sees a slot before
+ *        it is committed, so frames can't be torn
+ * @param length = bytes written into the reserved slot, 0 to release it unused
+ * @return false if length is over TX_SLOT_SIZE, the slot is released and the
+ *         message counted as dropped
+ *****************************************************************************/
+bool LDMA_TX_Commit(uint8_t length);
+
+/******************************************************************************
+ * @brief Hold back the DMA so the slots committed next go out as one burst
+ *        (one descriptor chain) once LDMA_TX_Release() is called
+ * @param none
+ * @return none
+ *****************************************************************************/
+void LDMA_TX_Hold(void);
+
+/******************************************************************************
+ * @brief End LDMA_TX_Hold(), start a chain over every queued slot if the
+ *        DMA is idle
+ * @param none
+ * @return none
+ *****************************************************************************/
+void LDMA_TX_Release(void);
+
+/******************************************************************************
+ * @brief Number of queued messages, including the ones being transmitted
+ * @param none
+ * @return queue depth (0 - TX_QUEUE_DEPTH)
+ *****************************************************************************/
+uint8_t LDMA_TX_Queue_Depth(void);
+
+/******************************************************************************
+ * @brief Check whether anything is still queued or being shifted out
+ * @param none
+ * @return true until the last byte of the last chain has left the LEUART
+ *****************************************************************************/
+bool LDMA_TX_Busy(void);
+
+/******************************************************************************
+ * @brief Number of messages dropped because the queue was full or they were
+ *        longer than a slot
+ * @param none
+ * @return drop counter since reset
+ *****************************************************************************/
+uint32_t LDMA_TX_Drops(void);
+
+/******************************************************************************
+ * @brief Called on LEUART TXC: release the LEUART energy mode block if no new
+ *        chain has been started since the last one finished
+ * @param none
  * @return none
  *****************************************************************************/
-void LDMA_ftoa_send(float number);
+void LDMA_TX_Idle(void);
 
 #endif /* SRC_LDMA_H_ */
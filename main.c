@@ -22,6 +22,7 @@
 #include "em_chip.h"
 #include "em_cmu.h"
 #include "em_emu.h"
+#include "em_core.h"
 #include "bsp.h"
 
 #include "sleep.h"
@@ -35,18 +36,157 @@
 #include "i2ctemp.h"
 #include "touch.h"
 #include "capsense.h"
-#include "cryotimer.h"
+#include "isrtime.h"
+#include "command.h"
+#include "batch.h"
+#include "report.h"
+#include "adapt.h"
+#include "rtcc.h"
+#include "hibernate.h"
+#include "vtimer.h"
+#include "scheduler.h"
 
-char receive_buffer[RECEIVE_BUFFER_SIZE];
-uint8_t schedule_event;
-float celsius;
-extern int8_t TxBuffer[TX_BUFFER_SIZE];
+int32_t temperature;                                         // last reading in hundredths of a degree (C or F)
+uint16_t temperature_code;                                   // last raw Si7021 code, for FORMAT_BINARY_RAW
+bool temperature_alert;                                      // alert threshold crossed by the last reading
+extern volatile uint16_t temp_ms_read;
+extern volatile uint16_t temp_ls_read;
 extern volatile bool isCelsius;
-extern LDMA_Descriptor_t ldmaTXDescriptor;
-extern LDMA_TransferCfg_t ldmaTXConfig;
+Format_Options tx_format = FORMAT_OPTIONS_DEFAULT;           // layout of the ASCII telemetry frame
+Report_Mode report_mode = REPORT_STREAM;                     // set with the 'm' command
 bool isPressed;
 bool disable_letimer = false;
 bool letimer_enabled = true;
+volatile bool sample_done;                                   // this period's measurement has been handled, cleared at COMP0
+
+/******************************************************************************
+ * @brief MEASURE_TEMP: Si7021 powered up by LETIMER COMP0
+ * @param none
+ * @return none
+ *****************************************************************************/
+static void Task_Measure_Temp(void) {
+    Temp_Measurement_Start();                                // non-blocking, posts CONVERT_TEMP when done
+}
+/******************************************************************************
+ * @brief FETCH_TEMP: No-Hold conversion time elapsed (conversion VTimer)
+ * @param none
+ * @return none
+ *****************************************************************************/
+static void Task_Fetch_Temp(void) {
+    Temp_Measurement_Fetch();                                // short read, posts CONVERT_TEMP when done
+}
+/******************************************************************************
+ * @brief CONVERT_TEMP: I2C read finished, convert the reading, adapt the
+ *        period and decide whether to report it
+ * @param none
+ * @return SEND_TEMP posted if the reading is to be sent
+ *****************************************************************************/
+static void Task_Convert_Temp(void) {
+    int32_t temperature_centi_c;
+    uint8_t report_reasons;
+
+    sample_done = true;                                      // SEND_TEMP, if posted, still runs before hibernation
+    if(Temp_Measurement_Finish()) {                          // power down sensor, check the read succeeded
+        temperature_code = (temp_ms_read << 8) | temp_ls_read;
+        temperature_centi_c = Temp_Code_To_Centi_Celsius(temp_ms_read, temp_ls_read);
+        if (isCelsius) {                                     // if user wants temp to be in celsius:
+            temperature = temperature_centi_c;
+        }
+        else {                                               // if user wants temp to be in fahrenheit:
+            temperature = Temp_Code_To_Centi_Fahrenheit(temp_ms_read, temp_ls_read);
+        }
+        Adapt_Sample(temperature_centi_c);                          // stretch or shrink the sample period
+        report_reasons = Report_Evaluate(temperature_centi_c);      // deadband, alert and heartbeat checks
+        temperature_alert = report_reasons & REPORT_REASON_ALERT;
+        if (letimer_enabled && (report_mode != REPORT_OFF)
+                && ((report_mode != REPORT_EXCEPTION) || report_reasons)) {
+            Report_Sent(temperature_centi_c);
+            Scheduler_Post(SEND_TEMP);
+        }
+    }
+}
+/******************************************************************************
+ * @brief SEND_TEMP: buffer the reading and send the batch when it is due
+ * @param none
+ * @return none
+ *****************************************************************************/
+static void Task_Send_Temp(void) {
+    Batch_Add(temperature, temperature_code, isCelsius);
+    if((report_mode != REPORT_BATCH) || Batch_Due(temperature_alert)) {
+        Batch_Flush(&tx_format);                             // queue frames, DMA drains the queue on its own
+    }
+}
+/******************************************************************************
+ * @brief RX_COMMAND: '#' received
+ * @param none
+ * @return none
+ *****************************************************************************/
+static void Task_Rx_Command(void) {
+    Command_Process();                                       // parse only the bytes received since last time
+}
+/******************************************************************************
+ * @brief Read the touch pad slowly while untouched and fast during a touch,
+ *        so the EM1 time of CAPSENSE_Sense follows actual use
+ * @param touched: a pad was pressed in this read
+ * @return none
+ *****************************************************************************/
+static void Touch_Rate_Update(bool touched) {
+#if !defined(CAPSENSE_LESENSE)                               // LESENSE reads are posted by touches, not a period
+    static uint8_t active_scans = 0;                         // fast reads left before going idle
+
+    if(touched) {
+        if(active_scans == 0) {
+            Scheduler_Set_Period(READ_TOUCH, TOUCH_ACTIVE_PERIOD_MS, TOUCH_ACTIVE_SLACK_MS);
+        }
+        active_scans = TOUCH_ACTIVE_SCANS;
+    }
+    else if(active_scans > 0 && --active_scans == 0) {
+        Scheduler_Set_Period(READ_TOUCH, TOUCH_IDLE_PERIOD_MS, TOUCH_IDLE_SLACK_MS);
+    }
+#else
+    (void)touched;
+#endif
+}
+/******************************************************************************
+ * @brief READ_TOUCH: read the touch pad, a new press toggles temperature
+ *        reporting
+ * @param none
+ * @return none
+ *****************************************************************************/
+static void Task_Read_Touch(void) {
+    static int state = 0;                                    // retain state of button press
+
+    CAPSENSE_Sense();                                        // read all capsense areas
+    isPressed = CAPSENSE_getPressed(TOUCH_CHANNEL0);         // retrieve if channel 0 is pressed
+
+    if(isPressed && state == 0) {                            // if pressed and not pressed before
+        disable_letimer ^= true;                             // toggle letimer disable
+        state = 1;                                           // we now pressed before
+    }
+    else if (!isPressed && state == 1){                      // if not pressed and pressed before
+        state = 0;                                           // we have not pressed before
+    }
+    Touch_Rate_Update(isPressed);
+
+    if(!disable_letimer && !letimer_enabled) {
+        letimer_enabled = 1;                                        // don't do this if statement again until we disable letimer again
+        sample_done = false;                                        // no hibernation before the first sample of the restarted timer
+        LETIMER0->CNT = 0;                                          // reset letimer to count from 0
+        LETIMER0->IFC = LETIMER_IEN_COMP0 | LETIMER_IEN_COMP1;      // clear comp1 and comp0 flags
+        LETIMER0->IEN = LETIMER_IEN_COMP0 | LETIMER_IEN_COMP1;      // re-enable interrupts
+        NVIC_EnableIRQ(LETIMER0_IRQn);                              // re-enable interrupts for LETIMER0 into the CORTEX-M3/4 CPU core
+    }
+}
+#if defined(CAPSENSE_LESENSE)
+/******************************************************************************
+ * @brief LESENSE saw a pad cross its threshold, read it in the main loop
+ * @param none
+ * @return none
+ *****************************************************************************/
+static void Touch_Changed(void) {
+    Scheduler_Post(READ_TOUCH);
+}
+#endif
 
 /******************************************************************************
  * @brief main
@@ -57,8 +197,10 @@ int main(void){
     EMU_DCDCInit_TypeDef dcdcInit = EMU_DCDCINIT_DEFAULT;
     CMU_HFXOInit_TypeDef hfxoInit = CMU_HFXOINIT_DEFAULT;
     EMU_EM23Init_TypeDef em23Init = EMU_EM23INIT_DEFAULT;
+    bool warm_boot;
 
     CHIP_Init();                                             // Chip errata
+    ISR_Timing_Init();                                       // start cycle counter for worst-case ISR timing
 
     EMU_DCDCInit(&dcdcInit);                                 // init DCDC regulator
     em23Init.vScaleEM23Voltage = emuVScaleEM23_LowPower;     // always start in low noise mode
@@ -66,54 +208,48 @@ int main(void){
     CMU_HFXOInit(&hfxoInit);                                 // init HFXO with kit specific parameters
 
     cmu_init();                                              // initialize clock trees
+    warm_boot = Hibernate_Resume();                          // EM4H wakeup: period, unit and batch come back from retention
+    RTCC_Setup();                                            // free-running timebase for sleep accounting
+    Sleep_Init();                                            // clear blocks and residency before any peripheral blocks
+    VTimer_Init();                                           // software timers on the RTCC compare channel
+    Scheduler_Init();                                        // tasks must exist before the first interrupt posts one
+    Scheduler_Add(MEASURE_TEMP, Task_Measure_Temp);
+    Scheduler_Add(FETCH_TEMP, Task_Fetch_Temp);
+    Scheduler_Add(CONVERT_TEMP, Task_Convert_Temp);
+    Scheduler_Add(SEND_TEMP, Task_Send_Temp);
+    Scheduler_Add(RX_COMMAND, Task_Rx_Command);
+    Scheduler_Add(READ_TOUCH, Task_Read_Touch);
     uart_init();
     gpio_init();                                             // sets up LED, I2C, and temp sensor enable pins
     LDMA_Setup();                                            // initialize DMA
     letimer_init();                                          // initialize letimer for LED and I2C operation
     I2C_Setup();                                             // initialize I2C
-    I2C_Reset_Bus();                                         // Reset I2C Bus
-    CAPSENSE_Init();                                         // initialize capsense
     LEUART0_Interrupt_Enable();                              // enable LEUART Interrupts
-    CRYOTIMER_setup();                                       // initialize cryotimer
-    CRYOTIMER_Interrupt_Enable();                            // enable cryotimer Interrupts
+    if (!warm_boot) {
+        I2C_Reset_Bus();                                     // after EM4H the sensor was unpowered, the bus is idle
+    }
+    else if (Hibernate_Button_Wakeup()) {                    // pressed while hibernating: stop sampling like a touch
+        disable_letimer = true;
+    }
+    CAPSENSE_setChannelMask(1UL << TOUCH_CHANNEL0);          // only the button is read
+    CAPSENSE_Init();                                         // on every boot, touch is not serviced in EM4H
+#if defined(CAPSENSE_LESENSE)
+    CAPSENSE_setCallback(Touch_Changed);                     // LESENSE scans in EM2, wake only on a touch
+#else
+    Scheduler_Set_Period(READ_TOUCH, TOUCH_IDLE_PERIOD_MS, TOUCH_IDLE_SLACK_MS);
+#endif
 
-    schedule_event = DO_NOTHING;
     while (1) {
-        if(schedule_event == DO_NOTHING) Enter_Sleep();      // enter EM3
-        if(schedule_event & SEND_TEMP){                      // send data to bluetooth
-            LDMA_ftoa_send(celsius);
-            if (isCelsius) {
-                TxBuffer[TX_BUFFER_SIZE - 1] = 0x43;         // Send C
-            }
-            else {
-                TxBuffer[TX_BUFFER_SIZE - 1] = 0x46;         // Send F
+        CORE_DECLARE_IRQ_STATE;
+        CORE_ENTER_CRITICAL();                               // a task posted after the check still wakes WFI
+        if(!Scheduler_Ready()) {                             // the next deadline is already on the RTCC
+            if(sample_done && letimer_enabled && Hibernate_Allowed()) {
+                Hibernate_Enter();                           // this period's sample handled, sleep in EM4H until the next one
             }
-            Sleep_Block_Mode(LEUART_EM_BLOCK);
-            LEUART0->CTRL |= LEUART_CTRL_TXDMAWU;            // DMA Wakeup
-            LDMA_StartTransfer(TX_DMA_CHANNEL, &ldmaTXConfig, &ldmaTXDescriptor);
-            schedule_event &= ~SEND_TEMP;
+            Enter_Sleep();                                   // enter EM3
         }
-        if(schedule_event & READ_TOUCH){
-            CAPSENSE_Sense();                                // read all capsense areas
-            isPressed = CAPSENSE_getPressed(TOUCH_CHANNEL0); // retrieve if channel 0 is pressed
+        CORE_EXIT_CRITICAL();
 
-            static int state = 0;                            // retain state of button press
-            if(isPressed && state == 0) {                    // if pressed and not pressed before
-                disable_letimer ^= true;                     // toggle letimer disable
-                state = 1;                                   // we now pressed before
-            }
-            else if (!isPressed && state == 1){              // if not pressed and pressed before
-                state = 0;                                   // we have not pressed before
-            }
-
-            if(!disable_letimer && !letimer_enabled) {
-                letimer_enabled = 1;                                        // don't do this if statement again until we disable letimer again
-                LETIMER0->CNT = 0;                                          // reset letimer to count from 0
-                LETIMER0->IFC = LETIMER_IEN_COMP0 | LETIMER_IEN_COMP1;      // clear comp1 and comp0 flags
-                LETIMER0->IEN = LETIMER_IEN_COMP0 | LETIMER_IEN_COMP1;      // re-enable interrupts
-                NVIC_EnableIRQ(LETIMER0_IRQn);                              // re-enable interrupts for LETIMER0 into the CORTEX-M3/4 CPU core
-            }
-            schedule_event &= ~READ_TOUCH;
-        }
+        Scheduler_Dispatch();                                // run every ready task, lowest id first
     }
 }
@@ -38,13 +38,32 @@
 #include <stdbool.h>
 #include "all.h"
 
-// define schedule event states
-#define DO_NOTHING 0
-#define SEND_TEMP 1
-#define READ_TOUCH 2
-//#define READ_TEMP 2
+// scheduler task ids, a lower id runs first when several are ready
+#define MEASURE_TEMP 0      // Si7021 powered up, start the I2C read
+#define FETCH_TEMP 1        // No-Hold conversion time elapsed, read the result
+#define CONVERT_TEMP 2      // I2C read finished, convert and queue the result
+#define SEND_TEMP 3
+#define RX_COMMAND 4        // LEUART signal frame received, parse the RX ring
+#define READ_TOUCH 5        // periodic, replaces the cryotimer tick
+
+#define TOUCH_IDLE_PERIOD_MS 1000
+#define TOUCH_IDLE_SLACK_MS 500     // untouched reads may ride along with a later temperature wakeup
+#define TOUCH_ACTIVE_PERIOD_MS 100  // while a touch is in progress
+#define TOUCH_ACTIVE_SLACK_MS 20
+#define TOUCH_ACTIVE_SCANS 10       // fast reads kept after the last touch before going idle
 
 #define TOUCH_CHANNEL0 0
 
+/******************************************************************************
+ * @brief What the device transmits after each measurement
+ *****************************************************************************/
+typedef enum {
+    REPORT_OFF,         // keep measuring, send nothing
+    REPORT_STREAM,      // send every sample (default)
+    REPORT_BATCH,       // buffer samples, send them in bursts (batch.h)
+    REPORT_EXCEPTION,   // send only on deadband, alert or heartbeat (report.h)
+    REPORT_MODE_COUNT
+} Report_Mode;
+
 
  #endif /* MAIN_H_ */
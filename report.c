@@ -0,0 +1,126 @@
+#include "report.h"
+
+static uint32_t report_deadband     = REPORT_DEADBAND_DEFAULT;
+static int32_t  report_alert        = REPORT_ALERT_DEFAULT;
+static uint32_t report_hysteresis   = REPORT_HYSTERESIS_DEFAULT;
+static uint32_t report_heartbeat_ms = REPORT_HEARTBEAT_DEFAULT_MS;
+
+static bool     alert_active;
+static bool     reported;                           // report_last is valid
+static int32_t  report_last;                        // last value queued for transmission
+static uint32_t since_report_ms;                    // sample periods since then, in ms
+
+/******************************************************************************
+ * @brief Run a new sample through the filter, called once per measurement.
+ *        The alert state is tracked in every report mode
+ * @param centi_c = temperature in hundredths of a degree celsius
+ * @return REPORT_REASON_* bits, 0 if the sample need not be reported
+ *****************************************************************************/
+uint8_t Report_Evaluate(int32_t centi_c) {
+    uint8_t reasons = 0;
+    int32_t change;
+
+    if (!alert_active && (centi_c >= report_alert)) {
+        alert_active = true;
+        reasons |= REPORT_REASON_ALERT;
+    }
+    else if (alert_active && (centi_c < (report_alert - (int32_t)report_hysteresis))) {
+        alert_active = false;                       // no chatter around the threshold
+        reasons |= REPORT_REASON_ALERT;
+    }
+
+    change = centi_c - report_last;
+    if (!reported || ((uint32_t)((change < 0) ? -change : change) > report_deadband)) {
+        reasons |= REPORT_REASON_DEADBAND;          // the first sample is always reported
+    }
+
+    since_report_ms += letimer_get_period();
+    if (report_heartbeat_ms && (since_report_ms >= report_heartbeat_ms)) {
+        reasons |= REPORT_REASON_HEARTBEAT;
+    }
+    return reasons;
+}
+/******************************************************************************
+ * @brief Record that a sample has been queued for transmission, the deadband
+ *        and heartbeat restart from it
+ * @param centi_c = temperature in hundredths of a degree celsius
+ * @return none
+ *****************************************************************************/
+void Report_Sent(int32_t centi_c) {
+    reported = true;
+    report_last = centi_c;
+    since_report_ms = 0;
+}
+/******************************************************************************
+ * @brief Alert state after the last sample
+ * @param none
+ * @return true between crossing the threshold and falling below the
+ *         threshold minus the hysteresis
+ *****************************************************************************/
+bool Report_Alert_Active(void) {
+    return alert_active;
+}
+/******************************************************************************
+ * @brief Set how far a sample must move from the last report to be sent
+ * @param deadband = hundredths of a degree celsius
+ * @return none
+ *****************************************************************************/
+void Report_Set_Deadband(uint32_t deadband) {
+    report_deadband = deadband;
+}
+/******************************************************************************
+ * @brief Set the alert threshold, the alert state is re-evaluated on the
+ *        next sample
+ * @param threshold = hundredths of a degree celsius
+ * @return none
+ *****************************************************************************/
+void Report_Set_Alert(int32_t threshold) {
+    report_alert = threshold;
+    alert_active = false;                           // re-evaluated against the new threshold
+}
+/******************************************************************************
+ * @brief Set how far below the threshold an alert clears
+ * @param hysteresis = hundredths of a degree celsius
+ * @return none
+ *****************************************************************************/
+void Report_Set_Hysteresis(uint32_t hysteresis) {
+    report_hysteresis = hysteresis;
+}
+/******************************************************************************
+ * @brief Set the longest time without a report
+ * @param heartbeat_ms = milliseconds, 0 disables the heartbeat
+ * @return none
+ *****************************************************************************/
+void Report_Set_Heartbeat(uint32_t heartbeat_ms) {
+    report_heartbeat_ms = heartbeat_ms;
+}
+/******************************************************************************
+ * @brief Copy the settings and the filter state out
+ * @param state = destination
+ * @return none
+ *****************************************************************************/
+void Report_Save(Report_Retained * state) {
+    state->alert           = report_alert;
+    state->deadband        = report_deadband;
+    state->hysteresis      = report_hysteresis;
+    state->heartbeat_ms    = report_heartbeat_ms;
+    state->last            = report_last;
+    state->since_report_ms = since_report_ms;
+    state->alert_active    = alert_active;
+    state->reported        = reported;
+}
+/******************************************************************************
+ * @brief Reload the state saved by Report_Save, e.g. after an EM4 wakeup
+ * @param state = source
+ * @return none
+ *****************************************************************************/
+void Report_Restore(const Report_Retained * state) {
+    report_alert        = state->alert;
+    report_deadband     = state->deadband;
+    report_hysteresis   = state->hysteresis;
+    report_heartbeat_ms = state->heartbeat_ms;
+    report_last         = state->last;
+    since_report_ms     = state->since_report_ms;
+    alert_active        = state->alert_active;
+    reported            = state->reported;
+}
@@ -0,0 +1,131 @@
+/**************************************************************************//**
+ * @file report.h
+ * @brief Report-by-exception filter header
+ * @author Silicon Labs
+ * @version 1.00
+ ******************************************************************************
+ * @section License
+ * <b>(C) Copyright 2014 Silicon Labs, http://www.silabs.com</b>
+ *******************************************************************************
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ * DISCLAIMER OF WARRANTY/LIMITATION OF REMEDIES: Silicon Labs has no
+ * obligation to support this Software. Silicon Labs is providing the
+ * Software "AS IS", with no express or implied warranties of any kind,
+ * including, but not limited to, any implied warranties of merchantability
+ * or fitness for any particular purpose or warranties against infringement
+ * of any proprietary rights of a third party.
+ *
+ * Silicon Labs will not be liable for any consequential, incidental, or
+ * special damages, or any other relief, or for any claim by any third party,
+ * arising from your use of this Software.
+ *
+ ******************************************************************************/
+#ifndef SRC_REPORT_H_
+#define SRC_REPORT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "timer.h"
+
+#define REPORT_DEADBAND_DEFAULT         50          // hundredths of a degree C (?eN#)
+#define REPORT_ALERT_DEFAULT  (TEMP_ALERT * 100)    // hundredths of a degree C (?aN#)
+#define REPORT_HYSTERESIS_DEFAULT       50          // alert clears this far below the threshold (?yN#)
+#define REPORT_HEARTBEAT_DEFAULT_MS 900000          // report at least every 15 minutes (?hN#), 0 = never
+
+/* reasons returned by Report_Evaluate() */
+#define REPORT_REASON_DEADBAND        0x01          // moved beyond the deadband since the last report
+#define REPORT_REASON_ALERT           0x02          // alert threshold crossed, either direction
+#define REPORT_REASON_HEARTBEAT       0x04          // nothing reported for the heartbeat interval
+
+/******************************************************************************
+ * @brief Settings and filter state, kept across EM4 hibernation
+ *****************************************************************************/
+typedef struct {
+    int32_t  alert;
+    uint32_t deadband;
+    uint32_t hysteresis;
+    uint32_t heartbeat_ms;
+    int32_t  last;                                  // last value queued for transmission
+    uint32_t since_report_ms;
+    bool     alert_active;
+    bool     reported;
+} Report_Retained;
+
+/******************************************************************************
+ * @brief Run a new sample through the filter, called once per measurement.
+ *        The alert state is tracked in every report mode
+ * @param centi_c = temperature in hundredths of a degree celsius
+ * @return REPORT_REASON_* bits, 0 if the sample need not be reported
+ *****************************************************************************/
+uint8_t Report_Evaluate(int32_t centi_c);
+
+/******************************************************************************
+ * @brief Record that a sample has been queued for transmission, the deadband
+ *        and heartbeat restart from it
+ * @param centi_c = temperature in hundredths of a degree celsius
+ * @return none
+ *****************************************************************************/
+void Report_Sent(int32_t centi_c);
+
+/******************************************************************************
+ * @brief Alert state after the last sample
+ * @param none
+ * @return true between crossing the threshold and falling below the
+ *         threshold minus the hysteresis
+ *****************************************************************************/
+bool Report_Alert_Active(void);
+
+/******************************************************************************
+ * @brief Set how far a sample must move from the last report to be sent
+ * @param deadband = hundredths of a degree celsius
+ * @return none
+ *****************************************************************************/
+void Report_Set_Deadband(uint32_t deadband);
+
+/******************************************************************************
+ * @brief Set the alert threshold, the alert state is re-evaluated on the
+ *        next sample
+ * @param threshold = hundredths of a degree celsius
+ * @return none
+ *****************************************************************************/
+void Report_Set_Alert(int32_t threshold);
+
+/******************************************************************************
+ * @brief Set how far below the threshold an alert clears
+ * @param hysteresis = hundredths of a degree celsius
+ * @return none
+ *****************************************************************************/
+void Report_Set_Hysteresis(uint32_t hysteresis);
+
+/******************************************************************************
+ * @brief Set the longest time without a report
+ * @param heartbeat_ms = milliseconds, 0 disables the heartbeat
+ * @return none
+ *****************************************************************************/
+void Report_Set_Heartbeat(uint32_t heartbeat_ms);
+
+/******************************************************************************
+ * @brief Copy the settings and the filter state out
+ * @param state = destination
+ * @return none
+ *****************************************************************************/
+void Report_Save(Report_Retained * state);
+
+/******************************************************************************
+ * @brief Reload the state saved by Report_Save, e.g. after an EM4 wakeup
+ * @param state = source
+ * @return none
+ *****************************************************************************/
+void Report_Restore(const Report_Retained * state);
+
+#endif /* SRC_REPORT_H_ */
@@ -0,0 +1,23 @@
+#include "rtcc.h"
+
+/******************************************************************************
+ * @brief Start the RTCC as a free-running 32 bit counter. It keeps counting
+ *        in EM0-EM2 and through EM4H, and wraps after about 36 hours, so only
+ *        differences of timestamps are meaningful
+ * @param none
+ * @return none
+ *****************************************************************************/
+void RTCC_Setup(void) {
+    if (RTCC->CTRL & RTCC_CTRL_ENABLE) {
+        return;                                                 // kept running through EM4H, stay continuous
+    }
+
+    RTCC_Init_TypeDef RTCC_init_struct = RTCC_INIT_DEFAULT;    // (set to default)
+    RTCC_init_struct.enable   = false;                          // (modify from default)
+    RTCC_init_struct.debugRun = false;                          // stop while the debugger halts the core
+    RTCC_init_struct.presc    = rtccCntPresc_1;                 // one tick per LFXO period
+
+    RTCC_Init(&RTCC_init_struct);
+    RTCC->CNT = 0;
+    RTCC_Enable(true);
+}
@@ -0,0 +1,62 @@
+/**************************************************************************//**
+ * @file rtcc.h
+ * @brief Free-running RTCC time base header
+ * @author Silicon Labs
+ * @version 1.00
+ ******************************************************************************
+ * @section License
+ * <b>(C) Copyright 2014 Silicon Labs, http://www.silabs.com</b>
+ *******************************************************************************
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ * DISCLAIMER OF WARRANTY/LIMITATION OF REMEDIES: Silicon Labs has no
+ * obligation to support this Software. Silicon Labs is providing the
+ * Software "AS IS", with no express or implied warranties of any kind,
+ * including, but not limited to, any implied warranties of merchantability
+ * or fitness for any particular purpose or warranties against infringement
+ * of any proprietary rights of a third party.
+ *
+ * Silicon Labs will not be liable for any consequential, incidental, or
+ * special damages, or any other relief, or for any claim by any third party,
+ * arising from your use of this Software.
+ *
+ ******************************************************************************/
+#ifndef SRC_RTCC_H_
+#define SRC_RTCC_H_
+
+#include <stdint.h>
+#include "em_rtcc.h"
+
+#define RTCC_FREQ                32768      // LFXO through LFECLK, no prescaler
+#define RTCC_TICKS_TO_MS(ticks)  ((uint32_t)(((uint64_t)(ticks) * 1000) / RTCC_FREQ))
+#define RTCC_MS_TO_TICKS(ms)     ((uint32_t)(((uint64_t)(ms) * RTCC_FREQ) / 1000))
+#define RTCC_US_TO_TICKS(us)     ((uint32_t)((((uint64_t)(us) * RTCC_FREQ) + 999999) / 1000000))   // rounded up
+
+/******************************************************************************
+ * @brief Start the RTCC as a free-running 32 bit counter. It keeps counting
+ *        in EM0-EM2 and through EM4H, and wraps after about 36 hours, so only
+ *        differences of timestamps are meaningful
+ * @param none
+ * @return none
+ *****************************************************************************/
+void RTCC_Setup(void);
+
+/******************************************************************************
+ * @brief Current RTCC timestamp
+ * @param none
+ * @return counter value in 1/RTCC_FREQ second ticks
+ *****************************************************************************/
+static inline uint32_t RTCC_Now(void) {
+    return RTCC->CNT;
+}
+
+#endif /* SRC_RTCC_H_ */
@@ -0,0 +1,114 @@
+#include "scheduler.h"
+#include "rtcc.h"
+#include <em_core.h>
+
+static Task tasks[SCHEDULER_MAX_TASKS];
+static volatile uint32_t scheduler_ready;          // bit id set while task id waits to run
+
+/******************************************************************************
+ * @brief Virtual timer callback of a timed task
+ * @param timer: &tasks[id].timer, context holds the id
+ * @return task posted
+ *****************************************************************************/
+static void Scheduler_Timer_Expired(VTimer * timer) {
+    scheduler_ready |= (1UL << (uintptr_t)timer->context);  // interrupts are already disabled here
+}
+
+/******************************************************************************
+ * @brief Clear all tasks. Call after VTimer_Init
+ * @param none
+ * @return none
+ *****************************************************************************/
+void Scheduler_Init(void) {
+    for(int i = 0; i < SCHEDULER_MAX_TASKS; i++) {
+        tasks[i].handler = NULL;
+        tasks[i].timer.active = false;
+        tasks[i].timer.callback = Scheduler_Timer_Expired;
+        tasks[i].timer.context = (void *)(uintptr_t)i;
+    }
+    scheduler_ready = 0;
+}
+/******************************************************************************
+ * @brief Register the handler of a task
+ * @param id: 0 to SCHEDULER_MAX_TASKS - 1, handler: runs in the main loop
+ * @return false for an invalid id
+ *****************************************************************************/
+bool Scheduler_Add(uint8_t id, Task_Handler handler) {
+    if(id >= SCHEDULER_MAX_TASKS) {
+        return false;
+    }
+    tasks[id].handler = handler;
+    return true;
+}
+/******************************************************************************
+ * @brief Run a task periodically, the first time one period from now
+ * @param id: registered task, period_ms: 0 stops it, slack_ms: how late
+ *        each run may be
+ * @return false for an invalid id
+ *****************************************************************************/
+bool Scheduler_Set_Period(uint8_t id, uint32_t period_ms, uint32_t slack_ms) {
+    if(id >= SCHEDULER_MAX_TASKS) {
+        return false;
+    }
+    if(period_ms == 0) {
+        VTimer_Stop(&tasks[id].timer);
+        return true;
+    }
+    VTimer_Start(&tasks[id].timer, RTCC_MS_TO_TICKS(period_ms), RTCC_MS_TO_TICKS(period_ms), RTCC_MS_TO_TICKS(slack_ms));
+    return true;
+}
+/******************************************************************************
+ * @brief Make a task ready, safe from interrupt handlers
+ * @param id: registered task
+ * @return false for an invalid id
+ *****************************************************************************/
+bool Scheduler_Post(uint8_t id) {
+    if(id >= SCHEDULER_MAX_TASKS) {
+        return false;
+    }
+    CORE_ATOMIC_SECTION(scheduler_ready |= (1UL << id);)
+    return true;
+}
+/******************************************************************************
+ * @brief Withdraw a posted task, its period keeps running
+ * @param id: registered task
+ * @return false for an invalid id
+ *****************************************************************************/
+bool Scheduler_Cancel(uint8_t id) {
+    if(id >= SCHEDULER_MAX_TASKS) {
+        return false;
+    }
+    CORE_ATOMIC_SECTION(scheduler_ready &= ~(1UL << id);)
+    return true;
+}
+/******************************************************************************
+ * @brief Post every task whose deadline has passed, whatever woke us, and
+ *        check whether anything is ready. Call with interrupts disabled,
+ *        right before sleeping
+ * @param none
+ * @return true if a task is ready, the caller must not sleep
+ *****************************************************************************/
+bool Scheduler_Ready(void) {
+    VTimer_Poll();                                  // also re-arms the RTCC for the next deadline
+    return scheduler_ready != 0;
+}
+/******************************************************************************
+ * @brief Run every ready task once, lowest id first
+ * @param none
+ * @return none
+ *****************************************************************************/
+void Scheduler_Dispatch(void) {
+    uint32_t ready;
+    CORE_DECLARE_IRQ_STATE;
+
+    CORE_ENTER_CRITICAL();
+    ready = scheduler_ready;                        // tasks posted while these run wait for the next pass
+    scheduler_ready = 0;
+    CORE_EXIT_CRITICAL();
+
+    for(int i = 0; i < SCHEDULER_MAX_TASKS; i++) {
+        if((ready & (1UL << i)) && (tasks[i].handler != NULL)) {
+            tasks[i].handler();
+        }
+    }
+}
@@ -0,0 +1,108 @@
+/**************************************************************************//**
+ * @file scheduler.h
+ * @brief Tickless task scheduler header
+ * @author Silicon Labs
+ * @version 1.00
+ ******************************************************************************
+ * @section License
+ * <b>(C) Copyright 2014 Silicon Labs, http://www.silabs.com</b>
+ *******************************************************************************
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ * DISCLAIMER OF WARRANTY/LIMITATION OF REMEDIES: Silicon Labs has no
+ * obligation to support this Software. Silicon Labs is providing the
+ * Software "AS IS", with no express or implied warranties of any kind,
+ * including, but not limited to, any implied warranties of merchantability
+ * or fitness for any particular purpose or warranties against infringement
+ * of any proprietary rights of a third party.
+ *
+ * Silicon Labs will not be liable for any consequential, incidental, or
+ * special damages, or any other relief, or for any claim by any third party,
+ * arising from your use of this Software.
+ *
+ ******************************************************************************/
+
+#ifndef SRC_SCHEDULER_H_
+#define SRC_SCHEDULER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "vtimer.h"
+#include "all.h"
+
+#define SCHEDULER_MAX_TASKS      8      // task ids 0-7, a lower id runs first
+
+typedef void (*Task_Handler)(void);
+
+/******************************************************************************
+ * @brief One task. It runs when posted, and also every period through its
+ *        virtual timer if it has one. A periodic task may run up to slack
+ *        late, which lets its wakeup merge with the wakeups of other tasks
+ *****************************************************************************/
+typedef struct {
+    Task_Handler handler;
+    VTimer       timer;         // posts the task when it expires
+} Task;
+
+/******************************************************************************
+ * @brief Clear all tasks. Call after VTimer_Init
+ * @param none
+ * @return none
+ *****************************************************************************/
+void Scheduler_Init(void);
+
+/******************************************************************************
+ * @brief Register the handler of a task
+ * @param id: 0 to SCHEDULER_MAX_TASKS - 1, handler: runs in the main loop
+ * @return false for an invalid id
+ *****************************************************************************/
+bool Scheduler_Add(uint8_t id, Task_Handler handler);
+
+/******************************************************************************
+ * @brief Run a task periodically, the first time one period from now
+ * @param id: registered task, period_ms: 0 stops it, slack_ms: how late
+ *        each run may be
+ * @return false for an invalid id
+ *****************************************************************************/
+bool Scheduler_Set_Period(uint8_t id, uint32_t period_ms, uint32_t slack_ms);
+
+/******************************************************************************
+ * @brief Make a task ready, safe from interrupt handlers
+ * @param id: registered task
+ * @return false for an invalid id
+ *****************************************************************************/
+bool Scheduler_Post(uint8_t id);
+
+/******************************************************************************
+ * @brief Withdraw a posted task, its period keeps running
+ * @param id: registered task
+ * @return false for an invalid id
+ *****************************************************************************/
+bool Scheduler_Cancel(uint8_t id);
+
+/******************************************************************************
+ * @brief Post every task whose deadline has passed, whatever woke us, and
+ *        check whether anything is ready. Call with interrupts disabled,
+ *        right before sleeping
+ * @param none
+ * @return true if a task is ready, the caller must not sleep
+ *****************************************************************************/
+bool Scheduler_Ready(void);
+
+/******************************************************************************
+ * @brief Run every ready task once, lowest id first
+ * @param none
+ * @return none
+ *****************************************************************************/
+void Scheduler_Dispatch(void);
+
+#endif /* SRC_SCHEDULER_H_ */
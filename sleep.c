@@ -34,73 +34,242 @@
 #include "sleep.h"
 #include <em_core.h>
 #include "em_emu.h"
+#include "rtcc.h"
 
 
 #define MAX_EM_Element 5
+#define SLEEP_BLOCK_BITS   6                         // block nesting count of each mode, max (2^6)-1 = 63
+#define SLEEP_BLOCK_MAX    ((1UL << SLEEP_BLOCK_BITS) - 1)
+#define SLEEP_BLOCK_SHIFT(EM)  (32 - SLEEP_BLOCK_BITS * ((EM) + 1))   // EM0 in the top bits, so __CLZ / SLEEP_BLOCK_BITS gives the lowest blocked mode
 
-static uint8_t sleepBlockEnable[MAX_EM_Element];     // max number of nested blocks is (2^8)-1 = 255
+_Static_assert(SLEEP_BLOCK_BITS * MAX_EM_Element <= 32, "sleepBlocks holds every mode's count");
 
+static volatile uint32_t sleepBlocks;                // nesting counts of all modes, one SLEEP_BLOCK_BITS field per mode
+
+static uint64_t sleepResidency[MAX_EM_Element];      // RTCC ticks spent in each mode, EM0 = awake
+static uint32_t sleepWakeups[MAX_EM_Element];        // number of wakeups from each mode
+static uint32_t sleepLastWake;                       // RTCC timestamp of the last wakeup
+
+static const Sleeper * sleepers[SLEEP_MAX_SLEEPERS]; // registered driver callbacks, called in order before sleep
+static uint8_t sleeperCount;
+static bool sleepClocksPending;                      // an EM2/EM3 wakeup skipped EMU_Restore()
+
+
+/******************************************************************************
+ * @brief Add delta to the block count of energy mode EM with LDREX/STREX, so
+ *        callers in any context never mask interrupts. An exception between
+ *        the load and the store clears the exclusive monitor and the update
+ *        is retried on the new value
+ * @param EM: energy mode whose count changes
+ * @param delta: +1 to block, -1 to unblock, ignored at the count limits
+ * @return sleepBlocks: global variable modified with the new count
+ *****************************************************************************/
+static void Sleep_Block_Update(unsigned int EM, int delta) {
+    uint32_t shift = SLEEP_BLOCK_SHIFT(EM);
+    uint32_t blocks;
+    uint32_t count;
+
+    do {
+       blocks = __LDREXW(&sleepBlocks);
+       count = (blocks >> shift) & SLEEP_BLOCK_MAX;
+       if (((delta > 0) && (count == SLEEP_BLOCK_MAX)) || ((delta < 0) && (count == 0))) {
+           __CLREX();                                // saturated or not blocked: leave the count alone
+           return;
+       }
+       blocks += (uint32_t)delta << shift;           // the field cannot carry or borrow into its neighbours
+    } while (__STREXW(blocks, &sleepBlocks) != 0);
+}
 
 /******************************************************************************
  * @brief Block energy mode on mode assigned by input EM
  * @param EM: energy mode to block on
- * @return sleepBlockEnable: global variable modified with new sleep mode block
+ * @return sleepBlocks: global variable modified with new sleep mode block
  *****************************************************************************/
 void Sleep_Block_Mode(unsigned int EM) {
-    CORE_ATOMIC_IRQ_DISABLE();
-    if(sleepBlockEnable[EM] < 255){
-       sleepBlockEnable[EM]++;                       // add block nesting to energy mode EM
-    }
-    CORE_ATOMIC_IRQ_ENABLE();
+    Sleep_Block_Update(EM, 1);                       // add block nesting to energy mode EM
 }
 
 /******************************************************************************
  * @brief Unlock energy mode on mode assigned by input EM
  * @param EM: energy mode to unblock on
- * @return sleepBlockEnable: global variable modified with new sleep mode unblock
+ * @return sleepBlocks: global variable modified with new sleep mode unblock
  *****************************************************************************/
 void Sleep_UnBlock_Mode(unsigned int EM) {
-    CORE_ATOMIC_IRQ_DISABLE();
-    if(sleepBlockEnable[EM] > 0){                    // check that energy mode is blocked
-       sleepBlockEnable[EM]--;                       // subtract block nesting to energy mode EM
-    }
-    CORE_ATOMIC_IRQ_ENABLE();
+    Sleep_Block_Update(EM, -1);                      // subtract block nesting to energy mode EM
 }
 
 /******************************************************************************
- * @brief Initialize energy modes to have no blocks
+ * @brief Initialize energy modes to have no blocks and clear the statistics
  * @param none
- * @return sleepBlockEnable: set all modes to have no blocks
+ * @return sleepBlocks: set all modes to have no blocks
  *****************************************************************************/
 void Sleep_Init(void) {
-    sleepBlockEnable[EnergyMode0] = 0;
-    sleepBlockEnable[EnergyMode1] = 0;
-    sleepBlockEnable[EnergyMode2] = 0;
-    sleepBlockEnable[EnergyMode3] = 0;
-    sleepBlockEnable[EnergyMode4] = 0;
+    CORE_DECLARE_IRQ_STATE;
+
+    CORE_ENTER_CRITICAL();
+    for(int i = 0; i < MAX_EM_Element; i++){
+        sleepResidency[i] = 0;
+        sleepWakeups[i] = 0;
+    }
+    sleepBlocks = 0;
+    sleeperCount = 0;
+    sleepClocksPending = false;
+    sleepLastWake = RTCC_Now();
+    CORE_EXIT_CRITICAL();
+}
+
+/******************************************************************************
+ * @brief Register driver callbacks with the sleep manager. All callbacks run
+ *        from Enter_Sleep with interrupts disabled and must not block
+ * @param sleeper: callbacks, any of them may be NULL. sleepCallback runs
+ *        before sleep and may veto it by returning false, wakeupCallback
+ *        runs after wakeup (or after a veto, for sleepers already called),
+ *        restoreCallback runs right after an EM2/EM3 wakeup and returns
+ *        SLEEP_FLAG_NO_CLOCK_RESTORE when it does not need the HF clocks
+ * @return false if SLEEP_MAX_SLEEPERS are already registered
+ *****************************************************************************/
+bool Sleep_Register(const Sleeper * sleeper) {
+    bool registered = false;
+    CORE_DECLARE_IRQ_STATE;
+
+    CORE_ENTER_CRITICAL();
+    if(sleeperCount < SLEEP_MAX_SLEEPERS){
+        sleepers[sleeperCount++] = sleeper;
+        registered = true;
+    }
+    CORE_EXIT_CRITICAL();
+    return registered;
 }
 
 /******************************************************************************
- * @brief Enter lowest unblocked sleep mode
- * @param sleepBlockEnable: used to determine which energy mode to enter based
- *        on which modes are currently blocked
+ * @brief Restore the oscillators and HF clock selection saved at the last
+ *        EM2/EM3 entry if that wakeup skipped it. Call before using a
+ *        peripheral whose timing depends on the configured HF clocks
+ * @param none
+ * @return none
+ *****************************************************************************/
+void Sleep_Restore_Clocks(void) {
+    CORE_DECLARE_IRQ_STATE;
+
+    CORE_ENTER_CRITICAL();
+    if(sleepClocksPending){
+        sleepClocksPending = false;
+        EMU_Restore();
+    }
+    CORE_EXIT_CRITICAL();
+}
+
+/******************************************************************************
+ * @brief Ask every sleeper with a restore callback whether the HF clocks are
+ *        needed after this wakeup
+ * @param emode: energy mode just left
+ * @return true only if at least one sleeper was asked and all of them
+ *         returned SLEEP_FLAG_NO_CLOCK_RESTORE
+ *****************************************************************************/
+static bool Sleep_Skip_Restore(EM emode) {
+    bool skip = false;
+
+    for(int i = 0; i < sleeperCount; i++){
+        if(sleepers[i]->restoreCallback != NULL){
+            if(!(sleepers[i]->restoreCallback(emode) & SLEEP_FLAG_NO_CLOCK_RESTORE)){
+                return false;                        // one HF user is enough to restore
+            }
+            skip = true;
+        }
+    }
+    return skip;
+}
+
+/******************************************************************************
+ * @brief Run wakeup callbacks in reverse registration order
+ * @param emode: energy mode just left, count: number of sleepers to notify
+ * @return none
+ *****************************************************************************/
+static void Sleep_Wakeup_Sleepers(EM emode, int count) {
+    for(int i = count - 1; i >= 0; i--){
+        if(sleepers[i]->wakeupCallback != NULL){
+            sleepers[i]->wakeupCallback(emode);
+        }
+    }
+}
+
+/******************************************************************************
+ * @brief Enter lowest unblocked sleep mode. Entry and exit are timestamped
+ *        with the RTCC; call with interrupts disabled so the exit timestamp
+ *        and the restore decision are taken before any interrupt handler runs
+ * @param sleepBlocks: the lowest blocked mode is its number of leading
+ *        zeros divided by SLEEP_BLOCK_BITS (5 when nothing is blocked)
  * @return none
  *****************************************************************************/
 void Enter_Sleep(void) {
-    if (sleepBlockEnable[0] > 0) {
+    uint32_t lowest_blocked = __CLZ(sleepBlocks) / SLEEP_BLOCK_BITS;
+    uint32_t sleep_start;
+    uint32_t sleep_end;
+    EM emode;
+
+    if (lowest_blocked <= EnergyMode1) {             // EM0 or EM1 blocked: stay awake
        return;
     }
-    else if (sleepBlockEnable[1] > 0) {
-       return;
+    emode = (lowest_blocked > EnergyMode3) ? EnergyMode3 : (EM)(lowest_blocked - 1);    // never EM4 from here
+
+    for(int i = 0; i < sleeperCount; i++){
+        if((sleepers[i]->sleepCallback != NULL) && !sleepers[i]->sleepCallback(emode)){
+            Sleep_Wakeup_Sleepers(emode, i);         // undo the shutdown of sleepers already called
+            return;
+        }
     }
-    else if (sleepBlockEnable[2] > 0) {
+    Sleep_Restore_Clocks();                          // emlib saves the clock state again on entry, it must be the full one
+
+    sleep_start = RTCC_Now();
+    if (emode == EnergyMode1) {
        EMU_EnterEM1();
     }
-    else if (sleepBlockEnable[3] > 0) {
-       EMU_EnterEM2(true);
+    else if (emode == EnergyMode2) {
+       EMU_EnterEM2(false);                          // restore decided below, HFRCO runs until then
     }
     else {
-       EMU_EnterEM3(true);
+       EMU_EnterEM3(false);
     }
-    return;
+    sleep_end = RTCC_Now();
+
+    if (emode >= EnergyMode2) {
+       if (Sleep_Skip_Restore(emode)) {
+           sleepClocksPending = true;                // taken by the first HF user or the next sleep entry
+       }
+       else {
+           EMU_Restore();
+       }
+    }
+
+    sleepResidency[EnergyMode0] += sleep_start - sleepLastWake;   // unsigned differences survive the counter wrap
+    sleepResidency[emode] += sleep_end - sleep_start;
+    sleepWakeups[emode]++;
+    sleepLastWake = sleep_end;
+
+    Sleep_Wakeup_Sleepers(emode, sleeperCount);
+}
+
+/******************************************************************************
+ * @brief Cumulative time spent in an energy mode, EM0 is time awake up to
+ *        the last sleep entry
+ * @param EM: energy mode to query
+ * @return residency in milliseconds (wraps after about 49 days)
+ *****************************************************************************/
+uint32_t Sleep_Residency_ms(unsigned int EM) {
+    uint64_t ticks;
+    CORE_DECLARE_IRQ_STATE;
+
+    CORE_ENTER_CRITICAL();
+    ticks = sleepResidency[EM];
+    CORE_EXIT_CRITICAL();
+    return RTCC_TICKS_TO_MS(ticks);
+}
+
+/******************************************************************************
+ * @brief Number of wakeups from an energy mode
+ * @param EM: energy mode to query
+ * @return wakeup count since Sleep_Init
+ *****************************************************************************/
+uint32_t Sleep_Wakeups(unsigned int EM) {
+    return sleepWakeups[EM];
 }
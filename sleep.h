@@ -42,6 +42,7 @@
 #define SLEEP_LOWEST_ENERGY_MODE_DEFAULT EnergyMode3
 #define SLEEP_FLAG_NO_CLOCK_RESTORE      0x1u
 #define MAX_NUM_SLEEP_MODES                 5
+#define SLEEP_MAX_SLEEPERS                  4
 
 typedef enum{
     EnergyMode0 = 0,
@@ -61,5 +62,9 @@ void Sleep_Block_Mode(unsigned int EM);
 void Sleep_UnBlock_Mode(unsigned int EM);
 void Sleep_Init(void);
 void Enter_Sleep(void);
+bool Sleep_Register(const Sleeper * sleeper);
+void Sleep_Restore_Clocks(void);
+uint32_t Sleep_Residency_ms(unsigned int EM);
+uint32_t Sleep_Wakeups(unsigned int EM);
 
 #endif /* SLEEP_H_ */
@@ -0,0 +1,30 @@
+#include "tempconv.h"
+
+/******************************************************************************
+ * @brief Convert temp code from si7021 temp sensor to celsius in integer math
+ * @param MSData = most significant byte of data from temp sensor,
+ *        LSData = least significant byte of data from temp sensor
+ * @return temperature in hundredths of a degree celsius (truncated toward 0)
+ *****************************************************************************/
+int32_t Temp_Code_To_Centi_Celsius(uint16_t MSData, uint16_t LSData) {
+    uint32_t scaled = TEMP_C_SCALE * ((MSData << 8) + LSData);     // unsigned: 4393 * 65535 fits, no overflow
+
+    if (scaled >= TEMP_C_OFFSET) {
+        return (scaled - TEMP_C_OFFSET) >> TEMP_C_SHIFT;
+    }
+    return -(int32_t)((TEMP_C_OFFSET - scaled) >> TEMP_C_SHIFT);    // truncate toward 0 like the float cast did
+}
+/******************************************************************************
+ * @brief Convert temp code from si7021 temp sensor to fahrenheit in integer math
+ * @param MSData = most significant byte of data from temp sensor,
+ *        LSData = least significant byte of data from temp sensor
+ * @return temperature in hundredths of a degree fahrenheit (truncated toward 0)
+ *****************************************************************************/
+int32_t Temp_Code_To_Centi_Fahrenheit(uint16_t MSData, uint16_t LSData) {
+    uint32_t scaled = TEMP_F_SCALE * ((MSData << 8) + LSData);     // 39537 * 65535 < 2^32
+
+    if (scaled >= TEMP_F_OFFSET) {
+        return (scaled - TEMP_F_OFFSET) / TEMP_F_DIV;               // constant divisor, compiles to a multiply
+    }
+    return -(int32_t)((TEMP_F_OFFSET - scaled) / TEMP_F_DIV);
+}
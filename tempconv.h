@@ -0,0 +1,65 @@
+/**************************************************************************//**
+ * @file tempconv.h
+ * @brief Si7021 temperature code conversion header
+ * @author Silicon Labs
+ * @version 1.00
+ ******************************************************************************
+ * @section License
+ * <b>(C) Copyright 2014 Silicon Labs, http://www.silabs.com</b>
+ *******************************************************************************
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ * DISCLAIMER OF WARRANTY/LIMITATION OF REMEDIES: Silicon Labs has no
+ * obligation to support this Software. Silicon Labs is providing the
+ * Software "AS IS", with no express or implied warranties of any kind,
+ * including, but not limited to, any implied warranties of merchantability
+ * or fitness for any particular purpose or warranties against infringement
+ * of any proprietary rights of a third party.
+ *
+ * Silicon Labs will not be liable for any consequential, incidental, or
+ * special damages, or any other relief, or for any claim by any third party,
+ * arising from your use of this Software.
+ *
+ ******************************************************************************/
+
+#ifndef SRC_TEMPCONV_H_
+#define SRC_TEMPCONV_H_
+
+#include <stdint.h>
+
+/* fixed point conversion, exact for the datasheet formula (175.72 * code / 65536) - 46.85:
+ * centi C = (4393 * code - 76759040) / 2^14
+ * centi F = (39537 * code - 428687360) / 81920 (= centi C * 9 / 5 + 3200, before truncation) */
+#define TEMP_C_SCALE             4393UL
+#define TEMP_C_OFFSET        76759040UL
+#define TEMP_C_SHIFT               14
+#define TEMP_F_SCALE            39537UL
+#define TEMP_F_OFFSET       428687360UL
+#define TEMP_F_DIV              81920UL
+
+/******************************************************************************
+ * @brief Convert temp code from si7021 temp sensor to celsius in integer math
+ * @param MSData = most significant byte of data from temp sensor,
+ *        LSData = least significant byte of data from temp sensor
+ * @return temperature in hundredths of a degree celsius (truncated toward 0)
+ *****************************************************************************/
+int32_t Temp_Code_To_Centi_Celsius(uint16_t MSData, uint16_t LSData);
+
+/******************************************************************************
+ * @brief Convert temp code from si7021 temp sensor to fahrenheit in integer math
+ * @param MSData = most significant byte of data from temp sensor,
+ *        LSData = least significant byte of data from temp sensor
+ * @return temperature in hundredths of a degree fahrenheit (truncated toward 0)
+ *****************************************************************************/
+int32_t Temp_Code_To_Centi_Fahrenheit(uint16_t MSData, uint16_t LSData);
+
+#endif /* SRC_TEMPCONV_H_ */
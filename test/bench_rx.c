@@ -0,0 +1,154 @@
+/* Command reception: the old interrupt scan against Command_Process.
+ *
+ * Each event is some line noise followed by one frame, then the SIGF
+ * interrupt. The frame is ?dC# style, or ?p1000# which the old scan did not
+ * know and so searched the whole buffer for. The old path gets the bytes in its DMA buffer and runs the
+ * RX part of the old LEUART0_IRQHandler. The new path gets them in the RX
+ * ring and runs Command_Process from command.c. Both must end up with the
+ * same unit after every event, and the new one must acknowledge each frame.
+ * The noise never holds '?', '#' or 'd', which the old scan would have
+ * taken as a command. Then the cost per event is compared, and the cost
+ * the old path added to every TXBL/TXC interrupt, where the new one does
+ * no RX work at all. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "legacy.h"
+#include "host_stubs.h"
+#include "command.h"
+
+#define EVENTS      20000
+#define MAX_NOISE   40
+#define EVENT_LEN   (MAX_NOISE + 7)
+
+extern volatile bool isCelsius;
+
+typedef struct {
+    uint8_t bytes[EVENT_LEN];
+    uint8_t length;
+} Event;
+
+static Event events[EVENTS];
+
+static void Make_Events(bool unit) {
+    static const uint8_t units[] = { 'c', 'C', 'f', 'F' };
+    uint8_t byte;
+
+    srand(9600);
+    for (int e = 0; e < EVENTS; e++) {
+        int noise = rand() % (MAX_NOISE + 1);
+
+        events[e].length = 0;
+        for (int i = 0; i < noise; i++) {
+            do {
+                byte = 1 + rand() % 255;
+            } while ((byte == '?') || (byte == '#') || ((byte | 0x20) == 'd'));
+            events[e].bytes[events[e].length++] = byte;
+        }
+        if (unit) {
+            memcpy(&events[e].bytes[events[e].length], "?d?#", 4);
+            events[e].bytes[events[e].length + 1] = (rand() & 1) ? 'd' : 'D';
+            events[e].bytes[events[e].length + 2] = units[rand() % 4];
+            events[e].length += 4;
+        }
+        else {
+            memcpy(&events[e].bytes[events[e].length], "?p1000#", 7);
+            events[e].length += 7;
+        }
+    }
+}
+
+/* the old DMA descriptor wrote from the start of the buffer */
+static void Legacy_Receive(const Event * event) {
+    memcpy(legacy_receive_buffer, event->bytes, event->length);
+}
+
+static int Check_Same_Unit(const char * reply) {
+    for (int e = 0; e < EVENTS; e++) {
+        uint32_t replies = host_replies;
+
+        Legacy_Receive(&events[e]);
+        Legacy_RX_Interrupt(true);
+        CHECK(Host_RX_Push(events[e].bytes, events[e].length));
+        Command_Process();
+        CHECK(legacy_celsius == isCelsius);
+        CHECK(host_replies == replies + 1);
+        CHECK(memcmp(host_last_reply, reply, 3) == 0);
+    }
+    return 0;
+}
+
+typedef struct {
+    uint64_t total;
+    uint64_t worst;
+} Cost;
+
+static Cost Time_Events(bool legacy) {
+    Cost best = { UINT64_MAX, UINT64_MAX };
+    uint64_t start, elapsed;
+
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        Cost cost = { 0, 0 };
+
+        for (int e = 0; e < EVENTS; e++) {
+            if (legacy) {
+                Legacy_Receive(&events[e]);                     /* done by the DMA, not timed */
+                start = Bench_Now();
+                Legacy_RX_Interrupt(true);
+            }
+            else {
+                Host_RX_Push(events[e].bytes, events[e].length);
+                start = Bench_Now();
+                Command_Process();
+            }
+            elapsed = Bench_Now() - start;
+            cost.total += elapsed;
+            if (elapsed > cost.worst) {
+                cost.worst = elapsed;
+            }
+        }
+        if (cost.total < best.total) {
+            best.total = cost.total;
+        }
+        if (cost.worst < best.worst) {
+            best.worst = cost.worst;                            /* least disturbed worst case */
+        }
+    }
+    return best;
+}
+
+static uint64_t Time_Other_Interrupt(void) {
+    uint64_t start, elapsed, best = UINT64_MAX;
+
+    for (int run = 0; run < BENCH_RUNS * 100; run++) {
+        start = Bench_Now();
+        Legacy_RX_Interrupt(false);
+        elapsed = Bench_Now() - start;
+        if (elapsed < best) {
+            best = elapsed;
+        }
+    }
+    return best;
+}
+
+int main(void) {
+    Cost old_cost, new_cost;
+
+    for (int unit = 1; unit >= 0; unit--) {
+        Make_Events(unit);
+        if (Check_Same_Unit(unit ? "!dK" : "!pK")) {
+            return 1;
+        }
+        old_cost = Time_Events(true);
+        new_cost = Time_Events(false);
+        printf("bench_rx: %d %s frames, same unit as the old scan after each, each acknowledged\n",
+               EVENTS, unit ? "?dC#" : "?p1000#");
+        printf("bench_rx:   %s per SIGF event: old scan %.1f (worst %llu), Command_Process %.1f (worst %llu)\n",
+               BENCH_UNIT, (double)old_cost.total / EVENTS, (unsigned long long)old_cost.worst,
+               (double)new_cost.total / EVENTS, (unsigned long long)new_cost.worst);
+    }
+    printf("bench_rx: %s added to every TXBL/TXC interrupt: old %llu, new 0\n",
+           BENCH_UNIT, (unsigned long long)Time_Other_Interrupt());
+    return 0;
+}
@@ -0,0 +1,78 @@
+/* Fixed point temperature path against the float one it replaced.
+ *
+ * Every 16 bit code is converted in both units. The new centi-degree values
+ * must equal the exact datasheet formula, truncated toward zero, and the
+ * 7 byte ASCII frame must equal the old one for every code the Si7021 can
+ * send (the two LSBs are always 0). Two kinds of difference are counted and
+ * reported instead: readings strictly between -1 and 0, where the old code
+ * converted a negative float to uint16_t (undefined, it sent '+' and a
+ * garbage tenths digit), and odd codes where float rounding carried into the
+ * next tenth. */
+#include <stdio.h>
+#include <string.h>
+#include "bench.h"
+#include "legacy.h"
+#include "tempconv.h"
+#include "format.h"
+
+static Format_Options ascii = FORMAT_OPTIONS_DEFAULT;
+
+static uint8_t New_Temp_Frame(uint8_t * frame, uint16_t code, bool celsius) {
+    int32_t centi = celsius ? Temp_Code_To_Centi_Celsius(code >> 8, code & 0xFF)
+                            : Temp_Code_To_Centi_Fahrenheit(code >> 8, code & 0xFF);
+
+    ascii.unit = celsius ? 'C' : 'F';
+    return Format_Fixed(frame, FORMAT_MAX_LEN, centi, &ascii);
+}
+
+/* exact value in hundredths, times 65536 (celsius) or 5 * 65536 (fahrenheit) */
+static int64_t Exact_Scaled(uint16_t code, bool celsius) {
+    int64_t c = (int64_t)17572 * code - (int64_t)4685 * 65536;
+
+    return celsius ? c : (c * 9) + ((int64_t)3200 * 5 * 65536);
+}
+
+static int Check_Exact(unsigned * band, unsigned * odd) {
+    uint8_t old_frame[LEGACY_TEMP_FRAME_LEN];
+    uint8_t new_frame[FORMAT_MAX_LEN];
+    int64_t exact, divisor;
+    int32_t centi;
+
+    for (int unit = 0; unit < 2; unit++) {
+        band[unit] = odd[unit] = 0;
+        for (uint32_t code = 0; code <= 0xFFFF; code++) {
+            exact = Exact_Scaled(code, unit == 0);
+            divisor = (unit == 0) ? 65536 : 5 * 65536;
+            centi = (unit == 0) ? Temp_Code_To_Centi_Celsius(code >> 8, code & 0xFF)
+                                : Temp_Code_To_Centi_Fahrenheit(code >> 8, code & 0xFF);
+            CHECK(centi == exact / divisor);                    /* C division truncates toward 0 */
+
+            Legacy_Temp_Frame(old_frame, code, unit == 0);
+            CHECK(New_Temp_Frame(new_frame, code, unit == 0) == LEGACY_TEMP_FRAME_LEN);
+            if (memcmp(old_frame, new_frame, LEGACY_TEMP_FRAME_LEN) == 0) {
+                continue;
+            }
+            if ((exact < 0) && (exact > -100 * divisor)) {
+                band[unit]++;                                   /* old: undefined float to uint16_t */
+                CHECK((new_frame[0] == '-') || (centi > -10));  /* new: signed, or "+   .0" above -0.1 */
+            }
+            else {
+                CHECK(code & 3);                                /* never for a code the sensor sends */
+                odd[unit]++;
+            }
+        }
+    }
+    return 0;
+}
+
+int main(void) {
+    unsigned band[2], odd[2];
+
+    if (Check_Exact(band, odd)) {
+        return 1;
+    }
+    printf("check_temp: new values equal the exact formula for all 65536 codes, C and F\n");
+    printf("check_temp: frames differ from the float path only for -1 < t < 0 (%u C, %u F codes)\n", band[0], band[1]);
+    printf("check_temp: and for odd codes the sensor never sends (%u C, %u F)\n", odd[0], odd[1]);
+    return 0;
+}
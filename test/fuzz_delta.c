@@ -0,0 +1,111 @@
+/* Round trip fuzz of the delta codec.
+ *
+ * Random, slowly drifting and extreme sequences are encoded into buffers of
+ * random size until Delta_Encode refuses a value. A refused value must leave
+ * the stream untouched, and the decoder must return exactly the accepted
+ * values, consume every byte and then stop. Random garbage is decoded too:
+ * the decoder must stay inside the buffer (built with ASan/UBSan) and never
+ * return more values than the bytes allow. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "delta.h"
+
+#define ITERATIONS   2000000
+#define MAX_VALUES   300            /* more than fit the largest buffer */
+#define MAX_BUF      255            /* Delta_Encoder.size is a uint8_t */
+
+static uint32_t seed = 0x5EED;
+
+static uint32_t Random(void) {          /* xorshift32, same sequence on every host */
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+static void Make_Values(uint16_t * values, int count) {
+    static const uint16_t extremes[] = { 0x0000, 0x0001, 0x7FFF, 0x8000, 0xFFFE, 0xFFFF };
+    int kind = Random() % 3;
+
+    values[0] = Random();
+    for (int i = 1; i < count; i++) {
+        if (kind == 0) {
+            values[i] = Random();
+        }
+        else if (kind == 1) {
+            values[i] = values[i - 1] + (int16_t)((Random() % 65) - 32);    /* Si7021 codes drift */
+        }
+        else {
+            values[i] = extremes[Random() % 6];
+        }
+    }
+}
+
+static int Round_Trip(void) {
+    uint16_t values[MAX_VALUES], decoded;
+    uint8_t buf[MAX_BUF], before[MAX_BUF];
+    uint8_t size = Random() % (MAX_BUF + 1);
+    Delta_Encoder enc;
+    Delta_Decoder dec;
+    int accepted = 0;
+
+    Make_Values(values, MAX_VALUES);
+    Delta_Encoder_Init(&enc, buf, size);
+    while (accepted < MAX_VALUES) {
+        uint8_t len = enc.len;
+
+        memcpy(before, buf, len);
+        if (!Delta_Encode(&enc, values[accepted])) {
+            CHECK((enc.len == len) && (enc.count == accepted));
+            CHECK(memcmp(before, buf, len) == 0);
+            CHECK((size - len) < ((accepted == 0) ? DELTA_BASE_LEN : DELTA_VARINT_MAX_LEN));
+            break;
+        }
+        CHECK(enc.len <= size);
+        accepted++;
+    }
+
+    Delta_Decoder_Init(&dec, buf, enc.len);
+    for (int i = 0; i < accepted; i++) {
+        CHECK(Delta_Decode(&dec, &decoded));
+        CHECK(decoded == values[i]);
+    }
+    CHECK(!Delta_Decode(&dec, &decoded));
+    CHECK(dec.pos == enc.len);
+    return 0;
+}
+
+static int Garbage(void) {
+    uint8_t len = Random() % (MAX_BUF + 1);
+    uint8_t * buf = malloc(len ? len : 1);                      /* exact size, so ASan sees overreads */
+    Delta_Decoder dec;
+    uint16_t value;
+    int count = 0;
+
+    for (int i = 0; i < len; i++) {
+        buf[i] = Random();
+    }
+    Delta_Decoder_Init(&dec, buf, len);
+    while (Delta_Decode(&dec, &value)) {
+        count++;
+    }
+    free(buf);
+    CHECK(dec.pos <= len);
+    CHECK((len < DELTA_BASE_LEN) ? (count == 0) : (count <= len - 1));
+    return 0;
+}
+
+int main(int argc, char ** argv) {
+    long iterations = (argc > 1) ? atol(argv[1]) : ITERATIONS;
+
+    for (long i = 0; i < iterations; i++) {
+        if (Round_Trip() || Garbage()) {
+            printf("fuzz_delta: failed at iteration %ld\n", i);
+            return 1;
+        }
+    }
+    printf("fuzz_delta: %ld round trips and garbage streams, no mismatch\n", iterations);
+    return 0;
+}
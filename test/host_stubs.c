@@ -0,0 +1,66 @@
+/* Everything command.c calls outside the parser. The RX ring is fed by the
+ * benchmark, replies are counted, the setters only succeed. */
+#include <string.h>
+#include "host_stubs.h"
+#include "command.h"
+#include "main.h"
+#include "uart.h"
+#include "ldma.h"
+#include "batch.h"
+#include "report.h"
+#include "adapt.h"
+#include "isrtime.h"
+
+RTCC_TypeDef host_rtcc;
+volatile bool isCelsius = true;
+Format_Options tx_format = FORMAT_OPTIONS_DEFAULT;
+Report_Mode report_mode = REPORT_STREAM;
+
+static uint8_t rx_ring[HOST_RX_RING_SIZE];
+static uint32_t rx_head, rx_tail;
+
+uint32_t host_replies;
+uint8_t host_last_reply[COMMAND_REPLY_LEN];
+
+bool Host_RX_Push(const uint8_t * data, uint32_t length) {
+    if (((rx_head - rx_tail) + length) > HOST_RX_RING_SIZE) {
+        return false;
+    }
+    for (uint32_t i = 0; i < length; i++) {
+        rx_ring[rx_head++ % HOST_RX_RING_SIZE] = data[i];
+    }
+    return true;
+}
+
+bool LDMA_RX_Read(uint8_t * data) {
+    if (rx_tail == rx_head) {
+        return false;
+    }
+    *data = rx_ring[rx_tail++ % HOST_RX_RING_SIZE];
+    return true;
+}
+
+bool LDMA_TX_Enqueue(const uint8_t * data, uint8_t length) {
+    host_replies++;
+    memcpy(host_last_reply, data, (length < COMMAND_REPLY_LEN) ? length : COMMAND_REPLY_LEN);
+    return true;
+}
+
+uint8_t LDMA_TX_Queue_Depth(void) { return 0; }
+uint32_t LDMA_TX_Drops(void) { return 0; }
+uint8_t Batch_Flush(const Format_Options * opts) { return 0; }
+bool Batch_Set_Size(uint32_t size) { return true; }
+void Batch_Set_Deadline(uint32_t deadline_ms) { }
+uint32_t Batch_Overruns(void) { return 0; }
+void Report_Set_Deadband(uint32_t deadband) { }
+void Report_Set_Alert(int32_t threshold) { }
+void Report_Set_Hysteresis(uint32_t hysteresis) { }
+void Report_Set_Heartbeat(uint32_t heartbeat_ms) { }
+void Adapt_Enable(bool enable) { }
+bool Adapt_Set_Floor(uint32_t floor_ms) { return true; }
+bool Adapt_Set_Ceiling(uint32_t ceiling_ms) { return true; }
+bool Adapt_Set_Rate(uint32_t rate) { return true; }
+bool Temp_Set_Resolution(uint8_t bits) { return true; }
+uint32_t ISR_Timing_Max(ISR_Id id) { return 0; }
+uint32_t Sleep_Residency_ms(unsigned int EM) { return 0; }
+uint32_t Sleep_Wakeups(unsigned int EM) { return 0; }
@@ -0,0 +1,16 @@
+/* Host side of the LDMA RX ring and TX queue, for checks that run command.c. */
+#ifndef TEST_HOST_STUBS_H_
+#define TEST_HOST_STUBS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define HOST_RX_RING_SIZE   4096
+
+extern uint32_t host_replies;           /* LDMA_TX_Enqueue calls */
+extern uint8_t host_last_reply[];
+
+/* bytes the RX DMA would have written, false if the ring is full */
+bool Host_RX_Push(const uint8_t * data, uint32_t length);
+
+#endif /* TEST_HOST_STUBS_H_ */
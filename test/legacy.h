@@ -0,0 +1,21 @@
+/* Pre-rewrite code paths the host benchmarks compare against. */
+#ifndef TEST_LEGACY_H_
+#define TEST_LEGACY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define LEGACY_TEMP_FRAME_LEN   7
+#define LEGACY_RX_BUFFER_SIZE   1000    /* RECEIVE_BUFFER_SIZE */
+
+/* float conversion and LDMA_ftoa_send, 7 byte "+ 23.4C" frame */
+void Legacy_Temp_Frame(uint8_t * frame, uint16_t code, bool celsius_unit);
+
+/* DMA destination of the old receiver, filled from index 0 up */
+extern char legacy_receive_buffer[LEGACY_RX_BUFFER_SIZE];
+extern volatile bool legacy_celsius;
+
+/* RX part of the old LEUART0_IRQHandler: scan on SIGF, zero on every interrupt */
+void Legacy_RX_Interrupt(bool sigf);
+
+#endif /* TEST_LEGACY_H_ */
@@ -0,0 +1,42 @@
+/* The receive path as it was before commands were parsed from the main loop
+ * (LEUART0_Receiver_Decoder and the RX part of LEUART0_IRQHandler in uart.c),
+ * kept as the reference for bench_rx. Every LEUART0 interrupt zeroed the
+ * whole DMA buffer, and SIGF scanned all of it for 'd' followed by a unit. */
+#include <stdint.h>
+#include <stdbool.h>
+#include "legacy.h"
+
+#define RECEIVE_BUFFER_SIZE  LEGACY_RX_BUFFER_SIZE
+#define LOWER_C              0x63
+#define UPPER_C              0x43
+#define LOWER_D              0x64
+#define UPPER_D              0x44
+#define LOWER_F              0x66
+#define UPPER_F              0x46
+
+char legacy_receive_buffer[LEGACY_RX_BUFFER_SIZE];
+volatile bool legacy_celsius = true;
+
+static void LEUART0_Receiver_Decoder(char * buffer) {
+    for(int i = 0; i < RECEIVE_BUFFER_SIZE-1; ++i) {
+        if ((buffer[i] == LOWER_D) || (buffer[i] == UPPER_D)) {
+            if ((buffer[i+1] == LOWER_C) || (buffer[i+1] == UPPER_C)) {
+                legacy_celsius = true;
+                break;
+            }
+            else if ((buffer[i+1] == LOWER_F) || (buffer[i+1] == UPPER_F)) {
+                legacy_celsius = false;
+                break;
+            }
+        }
+    }
+}
+
+void Legacy_RX_Interrupt(bool sigf) {
+    if (sigf) {
+        LEUART0_Receiver_Decoder(legacy_receive_buffer);        // Process data received
+    }
+    for (int i = 0; i < RECEIVE_BUFFER_SIZE; i++) {             // clear buffer
+        legacy_receive_buffer[i] = 0;
+    }
+}
@@ -0,0 +1,66 @@
+/* The float temperature path as it was before the fixed point rewrite
+ * (Temp_Code_To_Celsius in i2ctemp.c, the fahrenheit step in
+ * LETIMER0_IRQHandler and LDMA_ftoa_send in ldma.c), kept as the reference
+ * for check_temp. TxBuffer[0..5] is filled as before, the unit goes in [6]. */
+#include <stdint.h>
+#include <stdbool.h>
+#include "legacy.h"
+
+#define NEGATIVE_SIGN  0x2D
+#define POSITIVE_SIGN  0x2B
+#define DECIMAL_POINT  0x2E
+#define SPACE          0x20
+#define ASCII_OFFSET     48
+
+void Temp_Code_To_Celsius(uint16_t MSData, uint16_t LSData, float * DataRet) {
+    uint16_t Combined_Data1 = 0;
+    Combined_Data1 = (MSData << 8) + LSData;
+    *DataRet = ((175.72 * Combined_Data1) / 65536) - 46.85;
+}
+
+static void LDMA_ftoa_send(uint8_t * TxBuffer, float number) {
+    int16_t integer = (int16_t)number;
+    uint16_t decimal;
+
+    if(integer < 0) {                                   // test if negative
+        TxBuffer[0] = NEGATIVE_SIGN;                    // send negative sign
+        decimal = (((-1) * (number - integer)) * 10);   // find decimal value
+        integer = -1 * integer;                         // make value positive for all following operations
+    }
+    else {
+        TxBuffer[0] = POSITIVE_SIGN;                    // send positive sign
+        decimal = ((number - integer) * 10);            // find decimal values
+    }
+    if(((integer % 1000) / 100) != 0) {                 // hundreds place
+        TxBuffer[1] = ((integer / 100) + ASCII_OFFSET);
+    }
+    else {
+        TxBuffer[1] = 0x20;                             // if 0 value, send space instead
+    }
+    if((((integer % 100) / 10) != 0) || (((integer % 1000) / 100) != 0)) {  // tens place
+        TxBuffer[2] = (((integer % 100) / 10) + ASCII_OFFSET);
+    }
+    else {
+        TxBuffer[2] = 0x20;                             // if 0 value, send space instead
+    }
+    if(((integer % 10) != 0) || (((integer % 1000) / 100) != 0) || (((integer % 100) / 10) != 0)) {  // ones place
+        TxBuffer[3] = ((integer % 10) + ASCII_OFFSET);
+    }
+    else {
+        TxBuffer[3] = SPACE;                            // if 0 value, send space instead
+    }
+
+    TxBuffer[4] = DECIMAL_POINT;                        // decimal point
+    TxBuffer[5] = decimal + ASCII_OFFSET;               // tenths place
+}
+
+void Legacy_Temp_Frame(uint8_t * frame, uint16_t code, bool celsius_unit) {
+    float celsius;
+
+    Temp_Code_To_Celsius(code >> 8, code & 0xFF, &celsius);     // convert code sent from temp sensor into celsius
+    if (!celsius_unit) {
+        celsius = (celsius * 1.8) + 32;                         // convert celsius to fahrenheit
+    }
+    LDMA_ftoa_send(frame, celsius);
+    frame[6] = celsius_unit ? 'C' : 'F';
+}
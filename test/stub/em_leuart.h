@@ -0,0 +1 @@
+/* host build: the code under test does not touch the peripherals */
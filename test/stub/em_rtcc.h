@@ -0,0 +1,10 @@
+/* host build: only the counter read by RTCC_Now() */
+#pragma once
+#include <stdint.h>
+
+typedef struct {
+    volatile uint32_t CNT;
+} RTCC_TypeDef;
+
+extern RTCC_TypeDef host_rtcc;
+#define RTCC    (&host_rtcc)
@@ -1,59 +1,107 @@
 #include "timer.h"
+#include "isrtime.h"
+#include "em_core.h"
+#include "scheduler.h"
 
-volatile uint16_t temp_ms_read;
-volatile uint16_t temp_ls_read;
-extern float celsius;
-extern volatile bool isCelsius;
 extern bool disable_letimer;
 extern bool letimer_enabled;
-extern uint8_t schedule_event;
+extern volatile bool sample_done;
+
+static uint32_t letimer_period_ms = TEMP_MEAS_PERIOD_MS;       // period currently running
+static uint32_t letimer_powerup_ms = SENSOR_PWR_UP_MS;          // COMP0 to COMP1 currently running
+static volatile uint32_t letimer_ended_ms = TEMP_MEAS_PERIOD_MS;  // period that ended at the last COMP0
+static Letimer_Config pending_config;               // next period, loaded by the COMP0 interrupt
+static volatile bool period_pending;
+static volatile uint32_t period_start;              // RTCC timestamp of the last COMP0
 
 
 /******************************************************************************
- * @brief Configure LETIMER with to count down starting at COMP0, and interrupt
- *        when counter reaches COMP0 and COMP1 values
- *        - COMP0 interrupt used to start up Si7021 temp sensor by asserting enable
- *               pin
- *        - COMP1 interrupt used to retrieve temperature data through I2C from the
- *               Si7021 temp sensor
- *        - prescalar set to have highest resolution for given periods of COMP0
- *               and COMP1
- * @param TEMP_MEAS_PERIOD: can be modified in timer.h to change period of COMP1,
- *        SENSOR_PWR_UP can be modified in timer.h to change time between COMP1 and COMP0
+ * @brief Convert milliseconds to undivided LFXO ticks without overflow
+ * @param ms: up to TEMP_PERIOD_MAX_MS
+ * @return ticks, truncated
+ *****************************************************************************/
+static uint32_t letimer_ms_to_ticks(uint32_t ms) {
+    return ((ms / 1000) * LFXO_FREQ) + (((ms % 1000) * LFXO_FREQ) / 1000);
+}
+/******************************************************************************
+ * @brief Compute prescalar, COMP0 and COMP1 for a sample period in integer
+ *        math. The smallest prescalar that fits the period in 16 bits is the
+ *        number of significant bits above bit 15, so it is read off with one
+ *        count-leading-zeros instead of trying powers of 2
+ * @param period_ms: period of COMP0, powerup_ms: COMP0 to COMP1,
+ *        config: result
  * @return none
  *****************************************************************************/
-void letimer_init(void) {
-    uint32_t comp0;
-    uint32_t comp1;
-    uint8_t prescalar = 1;
-    uint8_t presc_power = 0;
-
-    do {
-        comp0 = (TEMP_MEAS_PERIOD * LFXO_FREQ) / prescalar;
-        if((comp0 > TIMER_MAX_COUNT) && (prescalar <= cmuClkDiv_16384)) {    // if comp0 is too big and if hardware supports larger prescalar
-            prescalar = prescalar << 1;                                      // prescalars are powers of 2
-                                                                             // (shift instead of multiply to reduce clock cycles and energy <3)
-            presc_power++;
-        }
-    }
-    while (comp0 > TIMER_MAX_COUNT);
+static void letimer_compute(uint32_t period_ms, uint32_t powerup_ms, Letimer_Config * config) {
+    uint32_t ticks = letimer_ms_to_ticks(period_ms);
+    uint8_t presc_power;
 
-    comp1 = comp0 - (SENSOR_PWR_UP * LFXO_FREQ) / prescalar;
+    presc_power = 32 - __CLZ(ticks >> 16);                                   // 0 if it already fits, __CLZ(0) = 32
 
+    config->period_ms   = period_ms;
+    config->powerup_ms  = powerup_ms;
+    config->presc_power = presc_power;
+    config->comp0       = ticks >> presc_power;
+    config->comp1       = config->comp0 - (letimer_ms_to_ticks(powerup_ms) >> presc_power);
+}
+/******************************************************************************
+ * @brief Load a computed configuration into the LETIMER. At boot the timer is
+ *        stopped, later this runs in the COMP0 interrupt: the counter has just
+ *        reloaded, so restarting it at the new top makes this the first
+ *        period at the new rate and no sample is dropped or doubled
+ * @param config: prescalar and compare values
+ * @return none
+ *****************************************************************************/
+static void letimer_load(const Letimer_Config * config) {
+    while(CMU->SYNCBUSY & CMU_SYNCBUSY_LFAPRESC0);                           // previous prescalar write must have reached the LF domain
+    CMU->LFAPRESC0 = (CMU->LFAPRESC0 & ~_CMU_LFAPRESC0_LETIMER0_MASK)        // set prescalar, leave the other LFA peripherals alone
+                   | ((uint32_t)config->presc_power << _CMU_LFAPRESC0_LETIMER0_SHIFT);
     while(LETIMER0->SYNCBUSY);                                               // wait for any previous writes to complete or be synchronized
-    CMU->LFAPRESC0 = presc_power;                                            // set prescalar
+    LETIMER0->CNT = config->comp0;                                           // restart the period at the new top
+    LETIMER_CompareSet(LETIMER0, 0, config->comp0);                          // set COMP0 to be the sample period
+    LETIMER_CompareSet(LETIMER0, 1, config->comp1);                          // set COMP1 to be the sensor power-up point
+
+    letimer_period_ms = config->period_ms;
+    letimer_powerup_ms = config->powerup_ms;
+}
+/******************************************************************************
+ * @brief Compute prescalar, COMP0 and COMP1 for letimer_period_ms and load
+ *        them into the (stopped) LETIMER
+ * @param letimer_period_ms: period of COMP0, letimer_powerup_ms: COMP0 to
+ *        COMP1, both in milliseconds
+ * @return none
+ *****************************************************************************/
+static void letimer_configure(void) {
+    Letimer_Config config;
 
-    LETIMER_CompareSet(LETIMER0, 0, comp0);                                  // set COMP0 to be period of LED PWM
-    LETIMER_CompareSet(LETIMER0, 1, comp1);                                  // set COMP1 to be the time the LED is on
+    letimer_compute(letimer_period_ms, letimer_powerup_ms, &config);
+    letimer_load(&config);
 
     /*initialize timer: no top buff, top is COMP0 = period, stops for
     debug halt, DON'T start timer after init completes, free-running mode: */
     LETIMER_Init_TypeDef LETIMER_init_struct = LETIMER_INIT_DEFAULT;         // (set to default)
     LETIMER_init_struct.comp0Top = true;                                     // (modify from default)
-    LETIMER_init_struct.topValue = comp0;                                    // (modify from default)
+    LETIMER_init_struct.topValue = config.comp0;                             // (modify from default)
     LETIMER_init_struct.enable = false;                                      // (modify from default)
 
     LETIMER_Init(LETIMER0, &LETIMER_init_struct);
+    LETIMER0->CNT = 0;                                                       // first COMP0 on the first tick, as after reset
+}
+/******************************************************************************
+ * @brief Configure LETIMER with to count down starting at COMP0, and interrupt
+ *        when counter reaches COMP0 and COMP1 values
+ *        - COMP0 interrupt used to start up Si7021 temp sensor by asserting enable
+ *               pin
+ *        - COMP1 interrupt used to retrieve temperature data through I2C from the
+ *               Si7021 temp sensor
+ *        - prescalar set to have highest resolution for given periods of COMP0
+ *               and COMP1
+ * @param TEMP_MEAS_PERIOD_MS: can be modified in timer.h to change period of COMP0,
+ *        SENSOR_PWR_UP_MS can be modified in timer.h to change time between COMP0 and COMP1
+ * @return none
+ *****************************************************************************/
+void letimer_init(void) {
+    letimer_configure();
 
     //interrupt config
     LETIMER0->IFC = LETIMER_IFC_COMP0 |LETIMER_IFC_COMP1;                    // clear flags
@@ -64,75 +112,115 @@ void letimer_init(void) {
 
     LETIMER_Enable(LETIMER0, true);                                          // START TIMER
 }
+/******************************************************************************
+ * @brief Change the temperature sample period at runtime. The new values
+ *        are computed here and loaded by the next COMP0 interrupt, so the
+ *        running period finishes undisturbed and the timer is not rebuilt
+ * @param period_ms: TEMP_PERIOD_MIN_MS to TEMP_PERIOD_MAX_MS,
+ *        powerup_ms: sensor power-up time before the measurement, at least
+ *        TEMP_MEASURE_MIN_MS shorter than period_ms
+ * @return false if out of range, nothing is changed then
+ *****************************************************************************/
+bool letimer_set_period(uint32_t period_ms, uint32_t powerup_ms) {
+    Letimer_Config config;
+
+    if ((period_ms < TEMP_PERIOD_MIN_MS) || (period_ms > TEMP_PERIOD_MAX_MS)
+            || (powerup_ms > (period_ms - TEMP_MEASURE_MIN_MS))) {
+        return false;
+    }
+    letimer_compute(period_ms, powerup_ms, &config);
+    CORE_ATOMIC_SECTION(
+        pending_config = config;                                             // a later request replaces an unapplied one
+        period_pending = true;
+    )
+    return true;
+}
+/******************************************************************************
+ * @brief Temperature sample period currently running
+ * @param none
+ * @return period in milliseconds
+ *****************************************************************************/
+uint32_t letimer_get_period(void) {
+    return letimer_period_ms;
+}
+/******************************************************************************
+ * @brief Sensor power-up time currently running
+ * @param none
+ * @return time between COMP0 and COMP1 in milliseconds
+ *****************************************************************************/
+uint32_t letimer_get_powerup(void) {
+    return letimer_powerup_ms;
+}
+/******************************************************************************
+ * @brief Period that ended at the last COMP0. COMP1 sits a fixed power-up
+ *        time after COMP0, so this is the time between the sample taken in
+ *        the current period and the previous one, also right after a change
+ * @param none
+ * @return period in milliseconds
+ *****************************************************************************/
+uint32_t letimer_get_ended_period(void) {
+    return letimer_ended_ms;
+}
+/******************************************************************************
+ * @brief Period that runs after the current one, a change requested by
+ *        letimer_set_period is only loaded at the next COMP0
+ * @param none
+ * @return period in milliseconds
+ *****************************************************************************/
+uint32_t letimer_get_next_period(void) {
+    uint32_t period_ms;
 
+    CORE_ATOMIC_SECTION(
+        period_ms = period_pending ? pending_config.period_ms : letimer_period_ms;
+    )
+    return period_ms;
+}
+/******************************************************************************
+ * @brief Start of the current period, LETIMER and RTCC both run on the LFXO
+ *        so the next COMP0 is exactly one period later
+ * @param none
+ * @return RTCC timestamp of the last COMP0
+ *****************************************************************************/
+uint32_t letimer_get_period_start(void) {
+    return period_start;
+}
 
 
 /******************************************************************************
  * @brief Handle COMP0 and COMP1 inerrupts to read temperature from Si7021 temp sensor
  *        - COMP0 interrupt used to start up Si7021 temp sensor by asserting enable
  *               pin
- *        - COMP1 interrupt used to retrieve temperature data through I2C from the
- *               Si7021 temp sensor
- * @param isCelsius: set to true if user wants to see temperature in celcsius and false
- *        if user want to see temp in fahrenheit, temp_ls_read: least-significant byte
- *        of temp code from Si7021, temp_ms_read: most-significant byte
- *        of temp code from Si7021, disable_letimer: set to true when user wants to disable
- *        temp transmission through bluetooth, letimer_enabled: set to true when the letimer
- *        is currently running
- * @return celsius: temperature value from si7021 after converted to celcius, schedule_event:
- *        bit set for current event that needs to be serviced
+ *        - COMP1 interrupt used to post the temperature read to the main loop,
+ *               the I2C transfer and conversion run there (Temp_Measurement_Start)
+ * @param disable_letimer: set to true when user wants to disable temp transmission
+ *        through bluetooth, letimer_enabled: set to true when the letimer is
+ *        currently running
+ * @return the task for the current event is posted to the scheduler
  *****************************************************************************/
 void LETIMER0_IRQHandler(void) { // COMP0 -> desired period for taking temp, COMP1 -> min time to power up Si7021
+    ISR_TIMING_START();
     uint32_t int_flags = LETIMER0->IF;
 
     if(int_flags & LETIMER_IFC_COMP0){                                            // if COMP0 flag is set,
+        period_start = RTCC_Now();                                                // anchor for the EM4H wakeup
+        sample_done = false;                                                      // no EM4H until this period's COMP1 sample is handled
+        letimer_ended_ms = letimer_period_ms;                                     // before a pending change replaces it
+        if(period_pending) {                                                      // period boundary: switch rate here
+            period_pending = false;
+            letimer_load(&pending_config);
+        }
         GPIO->P[SENS_EN_PORT].DOUT |= (1 << SENS_EN_PIN);                         // turn on temp sensor
         LETIMER0->IFC = LETIMER_IFC_COMP0;                                        // clear flag (by writing 1 to inter. clear reg)
     }
     if(int_flags & LETIMER_IFC_COMP1){                                            // if COMP1 flag is set,
-        /* LPM Enable Routine */
-        Sleep_Block_Mode(I2C_EM_BLOCK);                                           // set sleep mode block for master I2C operation
-        GPIO_PinModeSet(SCL_PORT, SCL_PIN, gpioModeWiredAnd, SCL_AND_SDA_DOUT);   // set up GPIO pin PC11 (SCL)
-        GPIO_PinModeSet(SDA_PORT, SDA_PIN, gpioModeWiredAnd, SCL_AND_SDA_DOUT);   // set up GPIO pin PC10 (SDA)
-        for (int i = 0; i < 9; i++) {                                             // reset slave I2C device state machine
-            GPIO_PinOutClear(SCL_PORT, SCL_PIN);
-            GPIO_PinOutSet(SCL_PORT, SCL_PIN);
-        }
-        I2C0->CMD = I2C_CMD_ABORT;                                                // reset pearl gecko I2C state machine
-        I2C0->IFC |= I2C_IFC_ACK;                                                 // clear ACK flag
-#ifdef RW_FROM_REGISTER
-        /* read/write routine */
-        for(int i = 0; i < 100000; i++);
-        I2C_Write_to_Reg_NoInterrupts(I2C_SLAVE_ADDRESS, USER_REG_1_W, USR_REG1_12BIT_RES);
-        for(int i = 0; i < 100000; i++);
-        I2C_Read_to_Reg_NoInterrupts(I2C_SLAVE_ADDRESS, USER_REG_1_R);            // read data from temp sensor
-        for(int i = 0; i < 100000; i++);
-#endif
-
-#ifdef READ_TEMPERATURE
-        I2C_Temperature_Read_NoInterrupts(I2C_SLAVE_ADDRESS, 0xE3);               // read data from temp sensor
-        if (isCelsius) {                                                          // if user wants temp to be in celsius:
-            Temp_Code_To_Celsius(temp_ms_read, temp_ls_read, &celsius);           // convert code sent from temp sensor into celsius
-        }
-        else {                                                                    // if user wants temp to be in fahrenheit:
-            Temp_Code_To_Celsius(temp_ms_read, temp_ls_read, &celsius);           // convert code sent from temp sensor into celsius
-            celsius = (celsius * 1.8) + 32;                                       // convert celsius to fahrenheit
-        }
-        schedule_event |= SEND_TEMP;                                              // set event flag to send temp to bluetooth module
-#endif
-
-        /* LPM Disable Routine */
-        GPIO_PinModeSet(SCL_PORT, SCL_PIN, gpioModeDisabled, SCL_AND_SDA_DOUT);   // disable GPIO pin PC11 (SCL)
-        GPIO_PinModeSet(SDA_PORT, SDA_PIN, gpioModeDisabled, SCL_AND_SDA_DOUT);   // disable GPIO pin PC10 (SDA)
-        GPIO->P[SENS_EN_PORT].DOUT &= ~(1 << SENS_EN_PIN);                        // turn off temp sensor
-        Sleep_UnBlock_Mode(I2C_EM_BLOCK);                                         // unblock sleep mode setting for I2C
-
+        Scheduler_Post(MEASURE_TEMP);                                             // sensor is powered up, read it from the main loop
         LETIMER0->IFC = LETIMER_IFC_COMP1;                                        // clear flag
         if(disable_letimer) {
             letimer_enabled = 0;
             LETIMER0->IEN &= ~(LETIMER_IEN_COMP0 | LETIMER_IEN_COMP1);            // disable interrupts
             NVIC_DisableIRQ(LETIMER0_IRQn);                                       // disable interrupts for TIMER0 into the CORTEX-M3/4 CPU core
-            schedule_event &= ~SEND_TEMP;                                         // stop sending temp
+            Scheduler_Cancel(SEND_TEMP);                                          // stop sending temp
         }
     }
+    ISR_TIMING_END(ISR_LETIMER0);
 }
@@ -42,6 +42,7 @@
 #include "i2ctemp.h"
 #include "i2c.h"
 #include "uart.h"
+#include "rtcc.h"
 #include "all.h"
 
 #define TIMER_MAX_COUNT    65535       //(2^16)-1
@@ -50,13 +51,27 @@
 //#define LED_ON_TIME           .5       //(in seconds)
 //#define LED_PERIOD             4       //(in seconds)
 
-#define SENSOR_PWR_UP        .08       //(in seconds)
-#define TEMP_MEAS_PERIOD       3       //(in seconds)
+#define SENSOR_PWR_UP_MS      80       //(in ms) default time between COMP0 and COMP1
+#define TEMP_MEAS_PERIOD_MS  3000       //(in ms) default period of COMP0
+#define TEMP_PERIOD_MIN_MS   200       //(in ms) sensor power-up plus a 14 bit conversion
+#define TEMP_PERIOD_MAX_MS   3600000   //(in ms) well inside 65535 ticks at LETIMER_MAX_PRESC
+#define TEMP_MEASURE_MIN_MS  ((CONV_TIME_14BIT_US / 1000) + 1) //(in ms) left after power-up for a conversion
 
 #define LETIMER_EM_BLOCK       3       //lowest mode for timer is 2, so block 3
 
 #define TEMP_ALERT            25
 
+/******************************************************************************
+ * @brief LETIMER settings for one sample period
+ *****************************************************************************/
+typedef struct {
+    uint32_t period_ms;
+    uint32_t powerup_ms;
+    uint8_t  presc_power;       // CMU LFAPRESC0, tick = 2^presc_power / LFXO_FREQ
+    uint32_t comp0;             // top, start of the period (sensor power on)
+    uint32_t comp1;             // sensor powered up, start the measurement
+} Letimer_Config;
+
 /******************************************************************************
  * @brief Configure LETIMER with to count down starting at COMP0, and interrupt
  *        when counter reaches COMP0 and COMP1 values
@@ -66,10 +81,60 @@
  *               Si7021 temp sensor
  *        - prescalar set to have highest resolution for given periods of COMP0
  *               and COMP1
- * @param TEMP_MEAS_PERIOD: can be modified in timer.h to change period of COMP1,
- *        SENSOR_PWR_UP can be modified in timer.h to change time between COMP1 and COMP0
+ * @param TEMP_MEAS_PERIOD_MS: can be modified in timer.h to change period of COMP0,
+ *        SENSOR_PWR_UP_MS can be modified in timer.h to change time between COMP0 and COMP1
  * @return none
  *****************************************************************************/
 void letimer_init(void);
 
+/******************************************************************************
+ * @brief Change the temperature sample period at runtime. The new values
+ *        are computed here and loaded by the next COMP0 interrupt, so the
+ *        running period finishes undisturbed and the timer is not rebuilt
+ * @param period_ms: TEMP_PERIOD_MIN_MS to TEMP_PERIOD_MAX_MS,
+ *        powerup_ms: sensor power-up time before the measurement, at least
+ *        TEMP_MEASURE_MIN_MS shorter than period_ms
+ * @return false if out of range, nothing is changed then
+ *****************************************************************************/
+bool letimer_set_period(uint32_t period_ms, uint32_t powerup_ms);
+
+/******************************************************************************
+ * @brief Temperature sample period currently running
+ * @param none
+ * @return period in milliseconds
+ *****************************************************************************/
+uint32_t letimer_get_period(void);
+
+/******************************************************************************
+ * @brief Sensor power-up time currently running
+ * @param none
+ * @return time between COMP0 and COMP1 in milliseconds
+ *****************************************************************************/
+uint32_t letimer_get_powerup(void);
+
+/******************************************************************************
+ * @brief Period that ended at the last COMP0. COMP1 sits a fixed power-up
+ *        time after COMP0, so this is the time between the sample taken in
+ *        the current period and the previous one, also right after a change
+ * @param none
+ * @return period in milliseconds
+ *****************************************************************************/
+uint32_t letimer_get_ended_period(void);
+
+/******************************************************************************
+ * @brief Period that runs after the current one, a change requested by
+ *        letimer_set_period is only loaded at the next COMP0
+ * @param none
+ * @return period in milliseconds
+ *****************************************************************************/
+uint32_t letimer_get_next_period(void);
+
+/******************************************************************************
+ * @brief Start of the current period, LETIMER and RTCC both run on the LFXO
+ *        so the next COMP0 is exactly one period later
+ * @param none
+ * @return RTCC timestamp of the last COMP0
+ *****************************************************************************/
+uint32_t letimer_get_period_start(void);
+
 #endif /* TIMER_H_ */
@@ -1,8 +1,10 @@
 #include "uart.h"
 #include "ldma.h"
+#include "isrtime.h"
+#include "main.h"
+#include "scheduler.h"
 
 volatile bool ready_to_TX;
-extern char receive_buffer[RECEIVE_BUFFER_SIZE];
 volatile bool isCelsius = true;
 
 /******************************************************************************
@@ -65,46 +67,6 @@ void UART_send_n(char * data, uint32_t length) {
         UART_send_byte(data[i]);                                    // Loop through data and send
     }
 }
-/******************************************************************************
- * @brief Convert a float input to ascii
- * @param A float number to be converted
- * @return none
- *****************************************************************************/
-void UART_ftoa_send(float number) {                                 // convert float to ascii value and send via UART
-    int16_t integer = (int16_t)number;
-    uint16_t decimal;
-
-    if(integer < 0) {                                               // test if negative
-        UART_send_byte(NEGATIVE_SIGN);                              // send negative sign
-        decimal = (((-1) * (number - integer)) * 10);               // find decimal value
-        integer = -1 * integer;                                     // make value positive for all following operations
-    }
-    else {
-        UART_send_byte(POSITIVE_SIGN);                              // send positive sign
-        decimal = ((number - integer) * 10);                        // find decimal values
-    }
-    if(((integer % 1000) / 100) != 0) {                             // hundreds place
-        UART_send_byte((integer / 100) + ASCII_OFFSET);
-    }
-    else {
-        UART_send_byte(0x20);                                       // if 0 value, send space instead
-    }
-    if((((integer % 100) / 10) != 0) || (((integer % 1000) / 100) != 0)) {  // tens place
-        UART_send_byte(((integer % 100) / 10) + ASCII_OFFSET);
-    }
-    else {
-        UART_send_byte(0x20);                                       // if 0 value, send space instead
-    }
-    if(((integer % 10) != 0) || (((integer % 1000) / 100) != 0) || (((integer % 100) / 10) != 0)) {     // ones place
-        UART_send_byte((integer % 10) + ASCII_OFFSET);
-    }
-    else {
-        UART_send_byte(SPACE);                                      // if 0 value, send space instead
-    }
-
-    UART_send_byte(DECIMAL_POINT);                                  // decimal point
-    UART_send_byte(decimal + ASCII_OFFSET);                         // tenths place
-}
 /******************************************************************************
  * @brief Enable LEUART0 Interrupts
  * @param none
@@ -124,31 +86,14 @@ void LEUART0_Interrupt_Disable(void) {
     LEUART0->IEN &= ~(LEUART_IEN_SIGF);
     NVIC_DisableIRQ(LEUART0_IRQn);
 }
-/******************************************************************************
- * @brief Switch between C to F depending on inputs. Handles random jibberish
- * @param Input buffer for decoding
- * @return isCelsius as a global if the user wants Celsius or Fahrenheit
- *****************************************************************************/
-static void LEUART0_Receiver_Decoder(char * buffer) {
-    for(int i = 0; i < RECEIVE_BUFFER_SIZE-1; ++i) {
-        if ((buffer[i] == LOWER_D) || (buffer[i] == UPPER_D)) {
-            if ((buffer[i+1] == LOWER_C) || (buffer[i+1] == UPPER_C)) {
-                isCelsius = true;
-                break;
-            }
-            else if ((buffer[i+1] == LOWER_F) || (buffer[i+1] == UPPER_F)) {
-                isCelsius = false;
-                break;
-            }
-        }
-    }
-}
 /******************************************************************************
  * @brief IRQ Handler for LEUART0
  * @param none
- * @return receive_buffer gets cleared
+ * @return RX_COMMAND posted when a frame has been received, the
+ *         bytes are parsed by Command_Process() in the main loop
  *****************************************************************************/
 void LEUART0_IRQHandler(void) {
+    ISR_TIMING_START();
     uint32_t status;
     status = LEUART0->IF & LEUART0->IEN;
     if(status & LEUART_IF_TXBL) {
@@ -157,15 +102,13 @@ void LEUART0_IRQHandler(void) {
     }
     if (status & LEUART_IF_SIGF) {
         LEUART0->CMD = LEUART_CMD_RXBLOCKEN;                    // enable block on RX UART buffer
-        LEUART0_Receiver_Decoder(receive_buffer);               // Process data received
+        Scheduler_Post(RX_COMMAND);                             // parse the new bytes in the main loop
         LEUART0->IFC = LEUART_IFC_SIGF;
     }
-    for (int i = 0; i < RECEIVE_BUFFER_SIZE; i++) {             // clear buffer
-        receive_buffer[i] = 0;
-    }
     if (status & LEUART_IF_TXC) {                               // if this statement is entered, we know that the last byte of DMA is complete
         LEUART0->IFC = LEUART_IFC_TXC;                          // clear TXC flag
         LEUART0->IEN &= ~LEUART_IEN_TXC;                        // disable TXC after last byte of DMA transfer has been signaled
-        Sleep_UnBlock_Mode(LEUART_EM_BLOCK);
+        LDMA_TX_Idle();                                         // unblock unless a new chain is already running
     }
+    ISR_TIMING_END(ISR_LEUART0);
 }
@@ -37,6 +37,7 @@
 #include <em_leuart.h>
 #include <em_gpio.h>
 #include "sleep.h"
+#include "format.h"
 
 #define LEUART_EM_BLOCK      3   // block EM3 to work down to EM2
 
@@ -55,8 +56,7 @@
 #define RX_PORT              gpioPortD
 #define RX_PIN               11
 
-#define TX_BUFFER_SIZE       7
-#define RECEIVE_BUFFER_SIZE  1000
+#define TX_BUFFER_SIZE       FORMAT_MAX_LEN
 
 // ASCII defines
 #define DECIMAL_POINT        0x2E
@@ -72,6 +72,9 @@
 #define UPPER_D              0x44
 #define LOWER_F              0x66
 #define UPPER_F              0x46
+#define EXCLAMATION_MARK     0x21
+#define UPPER_E              0x45
+#define UPPER_K              0x4B
 #define CF_CMD_IDX           0x02
 #define D_CMD_IDX            0x01
 
@@ -110,11 +113,4 @@ void LEUART0_Interrupt_Enable(void);
  *****************************************************************************/
 void LEUART0_Interrupt_Disable(void);
 
-/******************************************************************************
- * @brief Convert a number from float to ASCII and send over LEUART
- * @param number = number to convert and send
- * @return none
- *****************************************************************************/
-void UART_ftoa_send(float number);
-
 #endif /* SRC_UART_H_ */
@@ -0,0 +1,217 @@
+#include "vtimer.h"
+#include "rtcc.h"
+#include "sleep.h"
+#include "isrtime.h"
+#include <em_core.h>
+
+static VTimer * vtimer_head;                        // active timers, earliest expiry + slack first
+
+/******************************************************************************
+ * @brief Sleep restore callback: a timer wakeup only runs short callbacks,
+ *        so it skips the HF restore unless something else is pending as well
+ * @param emode: energy mode just left
+ * @return SLEEP_FLAG_NO_CLOCK_RESTORE if the RTCC is the only pending
+ *         interrupt, 0 otherwise
+ *****************************************************************************/
+static uint32_t VTimer_Restore(EM emode) {
+    if(!NVIC_GetPendingIRQ(RTCC_IRQn)) {
+        return 0;
+    }
+    for(int irq = 0; irq < EXT_IRQ_COUNT; irq++) {
+        if((irq != RTCC_IRQn) && NVIC_GetPendingIRQ((IRQn_Type)irq)) {
+            return 0;                               // someone else woke us as well
+        }
+    }
+    return SLEEP_FLAG_NO_CLOCK_RESTORE;
+}
+
+static const Sleeper vtimer_sleeper = { NULL, NULL, VTimer_Restore };
+
+/******************************************************************************
+ * @brief Link a timer into the list, sorted by the latest time it may fire.
+ *        Must be called with interrupts disabled
+ * @param timer: not in the list
+ * @return none
+ *****************************************************************************/
+static void VTimer_Insert(VTimer * timer) {
+    VTimer ** link = &vtimer_head;
+    uint32_t deadline = timer->expiry + timer->slack;
+
+    while((*link != NULL) && ((int32_t)(((*link)->expiry + (*link)->slack) - deadline) <= 0)) {
+        link = &(*link)->next;                      // equal deadlines keep start order
+    }
+    timer->next = *link;
+    *link = timer;
+    timer->active = true;
+}
+/******************************************************************************
+ * @brief Unlink a timer. Must be called with interrupts disabled
+ * @param timer: timer to remove, may not be in the list
+ * @return none
+ *****************************************************************************/
+static void VTimer_Remove(VTimer * timer) {
+    VTimer ** link = &vtimer_head;
+
+    while((*link != NULL) && (*link != timer)) {
+        link = &(*link)->next;
+    }
+    if(*link != NULL) {
+        *link = timer->next;
+    }
+    timer->active = false;
+}
+/******************************************************************************
+ * @brief Program the compare channel for the head of the list. Must be
+ *        called with interrupts disabled
+ * @param none
+ * @return none
+ *****************************************************************************/
+static void VTimer_Arm(void) {
+    uint32_t deadline;
+
+    if(vtimer_head == NULL) {
+        RTCC_IntDisable(RTCC_IEN_CC1);              // nothing timed, only other interrupts wake us
+        return;
+    }
+    deadline = vtimer_head->expiry + vtimer_head->slack;
+    RTCC_IntClear(RTCC_IFC_CC1);
+    RTCC_ChannelCCVSet(VTIMER_RTCC_CH, deadline);
+    RTCC_IntEnable(RTCC_IEN_CC1);
+    if((int32_t)(deadline - RTCC_Now()) < VTIMER_MIN_TICKS) {
+        NVIC_SetPendingIRQ(RTCC_IRQn);              // the compare may already be behind the counter
+    }
+}
+/******************************************************************************
+ * @brief Unlink the first timer in the list whose expiry has passed. Must be
+ *        called with interrupts disabled
+ * @param now: RTCC timestamp to compare against
+ * @return the expired timer, no longer active, or NULL if none
+ *****************************************************************************/
+static VTimer * VTimer_Pop_Expired(uint32_t now) {
+    VTimer ** link = &vtimer_head;
+    VTimer * timer;
+
+    while(*link != NULL) {                          // sorted by deadline, not expiry: check them all
+        timer = *link;
+        if((int32_t)(now - timer->expiry) >= 0) {
+            *link = timer->next;
+            timer->next = NULL;
+            timer->active = false;
+            return timer;
+        }
+        link = &timer->next;
+    }
+    return NULL;
+}
+/******************************************************************************
+ * @brief Fire every timer whose expiry has passed, reload the periodic ones
+ *        and program the next deadline if anything fired. Timers are taken
+ *        out one at a time, so a callback may start or stop any timer,
+ *        including one that has expired but not fired yet. Must be called
+ *        with interrupts disabled
+ * @param none
+ * @return none
+ *****************************************************************************/
+static void VTimer_Expire(void) {
+    uint32_t now = RTCC_Now();
+    VTimer * timer;
+    bool fired = false;
+
+    while((timer = VTimer_Pop_Expired(now)) != NULL) {
+        fired = true;
+        if(timer->period != 0) {
+            timer->expiry += timer->period;         // keep the cadence
+            if((int32_t)(now - timer->expiry) >= 0) {
+                timer->expiry = now + timer->period;    // fell more than a period behind, don't catch up
+            }
+            VTimer_Insert(timer);
+        }
+        timer->callback(timer);                     // may restart or stop this or any other timer
+    }
+    if(fired) {
+        VTimer_Arm();                               // otherwise the armed deadline is still the right one
+    }
+}
+/******************************************************************************
+ * @brief Empty the timer list and set up the RTCC compare channel. Call
+ *        after RTCC_Setup and Sleep_Init
+ * @param none
+ * @return none
+ *****************************************************************************/
+void VTimer_Init(void) {
+    RTCC_CCChConf_TypeDef compare = RTCC_CH_INIT_COMPARE_DEFAULT;
+
+    vtimer_head = NULL;
+    RTCC_ChannelInit(VTIMER_RTCC_CH, &compare);
+    RTCC_IntDisable(RTCC_IEN_CC1);
+    RTCC_IntClear(RTCC_IFC_CC1);
+    NVIC_ClearPendingIRQ(RTCC_IRQn);
+    NVIC_EnableIRQ(RTCC_IRQn);
+    Sleep_Register(&vtimer_sleeper);
+}
+/******************************************************************************
+ * @brief Start or restart a timer
+ * @param timer: caller owned, callback and context must be set,
+ *        delay: RTCC ticks to the first expiry, period: RTCC ticks between
+ *        later expiries or 0 for one-shot, slack: RTCC ticks each expiry may
+ *        be late, delay + slack at most VTIMER_MAX_TICKS
+ * @return none
+ *****************************************************************************/
+void VTimer_Start(VTimer * timer, uint32_t delay, uint32_t period, uint32_t slack) {
+    CORE_DECLARE_IRQ_STATE;
+
+    CORE_ENTER_CRITICAL();
+    if(timer->active) {
+        VTimer_Remove(timer);
+    }
+    timer->expiry = RTCC_Now() + delay;
+    timer->period = period;
+    timer->slack  = slack;
+    VTimer_Insert(timer);
+    if(vtimer_head == timer) {
+        VTimer_Arm();                               // new earliest deadline
+    }
+    CORE_EXIT_CRITICAL();
+}
+/******************************************************************************
+ * @brief Stop a timer, nothing happens if it is not running
+ * @param timer: timer to stop
+ * @return none
+ *****************************************************************************/
+void VTimer_Stop(VTimer * timer) {
+    CORE_DECLARE_IRQ_STATE;
+
+    CORE_ENTER_CRITICAL();
+    if(timer->active) {
+        VTimer_Remove(timer);
+        VTimer_Arm();
+    }
+    CORE_EXIT_CRITICAL();
+}
+/******************************************************************************
+ * @brief Fire every timer whose expiry has passed, even if its slack has
+ *        not, so a wakeup from any source serves them. Call with interrupts
+ *        disabled right before sleeping
+ * @param none
+ * @return none
+ *****************************************************************************/
+void VTimer_Poll(void) {
+    if(vtimer_head != NULL) {
+        VTimer_Expire();
+    }
+}
+/******************************************************************************
+ * @brief RTCC compare interrupt: fire the expired timers and arm the next
+ * @param none
+ * @return none
+ *****************************************************************************/
+void RTCC_IRQHandler(void) {
+    ISR_TIMING_START();
+    CORE_DECLARE_IRQ_STATE;
+
+    CORE_ENTER_CRITICAL();                          // Start/Stop from other handlers must not interleave
+    RTCC_IntClear(RTCC_IFC_CC1);
+    VTimer_Expire();
+    CORE_EXIT_CRITICAL();
+    ISR_TIMING_END(ISR_RTCC);
+}
@@ -0,0 +1,97 @@
+/**************************************************************************//**
+ * @file vtimer.h
+ * @brief Virtual timers on the RTCC header
+ * @author Silicon Labs
+ * @version 1.00
+ ******************************************************************************
+ * @section License
+ * <b>(C) Copyright 2014 Silicon Labs, http://www.silabs.com</b>
+ *******************************************************************************
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ * DISCLAIMER OF WARRANTY/LIMITATION OF REMEDIES: Silicon Labs has no
+ * obligation to support this Software. Silicon Labs is providing the
+ * Software "AS IS", with no express or implied warranties of any kind,
+ * including, but not limited to, any implied warranties of merchantability
+ * or fitness for any particular purpose or warranties against infringement
+ * of any proprietary rights of a third party.
+ *
+ * Silicon Labs will not be liable for any consequential, incidental, or
+ * special damages, or any other relief, or for any claim by any third party,
+ * arising from your use of this Software.
+ *
+ ******************************************************************************/
+
+#ifndef SRC_VTIMER_H_
+#define SRC_VTIMER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "all.h"
+
+#define VTIMER_RTCC_CH           1      // RTCC compare channel, only the earliest deadline is programmed
+#define VTIMER_MIN_TICKS         2      // closer deadlines are not armed, the interrupt is pended instead
+#define VTIMER_MAX_TICKS  0x7FFFFFFFUL  // deadlines are compared as signed differences (~18 hours)
+
+struct VTimer;
+typedef void (*VTimer_Callback)(struct VTimer * timer);
+
+/******************************************************************************
+ * @brief One software timer, owned by the caller and linked into the active
+ *        list while running. A timer may fire up to slack after its expiry
+ *        so its wakeup can be shared with other timers
+ *****************************************************************************/
+typedef struct VTimer {
+    struct VTimer * next;
+    uint32_t        expiry;         // RTCC timestamp
+    uint32_t        period;         // RTCC ticks, 0 = one-shot
+    uint32_t        slack;          // RTCC ticks the expiry may be missed by
+    VTimer_Callback callback;       // runs with interrupts disabled, keep it short
+    void *          context;        // for the callback
+    bool            active;
+} VTimer;
+
+/******************************************************************************
+ * @brief Empty the timer list and set up the RTCC compare channel. Call
+ *        after RTCC_Setup and Sleep_Init
+ * @param none
+ * @return none
+ *****************************************************************************/
+void VTimer_Init(void);
+
+/******************************************************************************
+ * @brief Start or restart a timer
+ * @param timer: caller owned, callback and context must be set,
+ *        delay: RTCC ticks to the first expiry, period: RTCC ticks between
+ *        later expiries or 0 for one-shot, slack: RTCC ticks each expiry may
+ *        be late, delay + slack at most VTIMER_MAX_TICKS
+ * @return none
+ *****************************************************************************/
+void VTimer_Start(VTimer * timer, uint32_t delay, uint32_t period, uint32_t slack);
+
+/******************************************************************************
+ * @brief Stop a timer, nothing happens if it is not running
+ * @param timer: timer to stop
+ * @return none
+ *****************************************************************************/
+void VTimer_Stop(VTimer * timer);
+
+/******************************************************************************
+ * @brief Fire every timer whose expiry has passed, even if its slack has
+ *        not, so a wakeup from any source serves them. Call with interrupts
+ *        disabled right before sleeping
+ * @param none
+ * @return none
+ *****************************************************************************/
+void VTimer_Poll(void);
+
+#endif /* SRC_VTIMER_H_ */